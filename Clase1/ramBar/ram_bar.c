@@ -6,14 +6,36 @@
 #include <linux/mm.h>
 #include <linux/sched.h>
 #include <linux/uaccess.h>
+#include <linux/slab.h>
+#include <linux/mmzone.h>   // Zonas de cada nodo NUMA
+#include <linux/vmstat.h>   // zone_page_state()
+#include <linux/swap.h>     // get_nr_swap_pages()
+#include <linux/nodemask.h>
+#include <linux/timekeeping.h>
+#include <linux/miscdevice.h>  // /dev/ram_watch
+#include <linux/poll.h>
+#include <linux/wait.h>
+#include <linux/workqueue.h>
+#include <linux/spinlock.h>
+#include <linux/list.h>
+#include <linux/kernel_stat.h> // kcpustat_cpu() para el uso de CPU
+#include <linux/cpumask.h>
+#include <linux/math64.h>
+#include <linux/mutex.h>
+
+#include "ram_bar.h"
 
 #define BAR_WIDTH 30
 
+// La barra se arma copiando pedazos de estas cadenas (una llamada en vez de una por carácter)
+static const char bar_full[BAR_WIDTH + 1]  = "##############################";
+static const char bar_empty[BAR_WIDTH + 1] = "                              ";
+
 static int ram_bar_show(struct seq_file *m, void *v)
 {
     struct sysinfo si;
     unsigned long total, free, used;
-    int percent, filled, i;
+    int percent, filled;
 
     si_meminfo(&si);
 
@@ -25,12 +47,8 @@ static int ram_bar_show(struct seq_file *m, void *v)
     filled = (percent * BAR_WIDTH) / 100;
 
     seq_puts(m, "[");
-
-    for (i = 0; i < filled; i++)
-        seq_putc(m, '#');
-    for (i = filled; i < BAR_WIDTH; i++)
-        seq_putc(m, ' ');
-
+    seq_write(m, bar_full, filled);
+    seq_write(m, bar_empty, BAR_WIDTH - filled);
     seq_printf(m, "] %d%%\n", percent);
 
     return 0;
@@ -48,15 +66,348 @@ static const struct proc_ops ram_bar_ops = {
     .proc_release = single_release,
 };
 
+/*
+ * /proc/ram_bar_stats: los mismos datos en binario (formato en ram_bar.h).
+ * Cada lectura desde la posición 0 toma una foto nueva, así que un recolector
+ * puede abrir el archivo una vez y repetir pread(fd, buf, size, 0).
+ */
+struct ram_bar_snapshot {
+    struct mutex lock;      // Dos pread() a la vez sobre el mismo fd no deben mezclar fotos
+    size_t size;            // Bytes válidos en 'data'
+    unsigned char data[];   // Cabecera + registros
+};
+
+// Cabecera + 1 registro del sistema + 1 por cada nodo posible
+static size_t ram_bar_stats_max(void)
+{
+    return sizeof(struct ram_bar_header) + (1 + nr_node_ids) * sizeof(struct ram_bar_record);
+}
+
+// Memoria de un nodo: suma de las páginas administradas y libres de sus zonas
+static void ram_bar_node(int nid, struct ram_bar_record *rec)
+{
+    pg_data_t *pgdat = NODE_DATA(nid);
+    unsigned long managed = 0, free = 0;
+    int z;
+
+    for (z = 0; z < MAX_NR_ZONES; z++) {
+        struct zone *zone = &pgdat->node_zones[z];
+
+        managed += zone_managed_pages(zone);
+        free += zone_page_state(zone, NR_FREE_PAGES);
+    }
+
+    memset(rec, 0, sizeof(*rec));
+    rec->type  = RAM_BAR_REC_NODE;
+    rec->node  = nid;
+    rec->total = (u64)managed << PAGE_SHIFT;
+    rec->free  = (u64)free << PAGE_SHIFT;
+    rec->used  = rec->total - rec->free;
+}
+
+static void ram_bar_fill(struct ram_bar_snapshot *snap)
+{
+    struct ram_bar_header *hdr = (struct ram_bar_header *)snap->data;
+    struct ram_bar_record *rec = (struct ram_bar_record *)(hdr + 1);
+    struct sysinfo si;
+    u32 n = 0;
+    int nid;
+
+    // 1. REGISTRO DEL SISTEMA
+    si_meminfo(&si);
+    memset(rec, 0, sizeof(*rec));
+    rec->type      = RAM_BAR_REC_SYSTEM;
+    rec->node      = -1;
+    rec->total     = (u64)si.totalram  * si.mem_unit;
+    rec->free      = (u64)si.freeram   * si.mem_unit;
+    rec->used      = rec->total - rec->free;
+    rec->shared    = (u64)si.sharedram * si.mem_unit;
+    rec->buffer    = (u64)si.bufferram * si.mem_unit;
+    rec->swap_free = (u64)get_nr_swap_pages() << PAGE_SHIFT;
+    n++;
+
+    // 2. UN REGISTRO POR NODO NUMA CON MEMORIA
+    for_each_node_state(nid, N_MEMORY) {
+        if (n > nr_node_ids)
+            break;
+        ram_bar_node(nid, &rec[n++]);
+    }
+
+    // 3. CABECERA
+    hdr->version      = RAM_BAR_STATS_VERSION;
+    hdr->nr_records   = n;
+    hdr->record_size  = sizeof(struct ram_bar_record);
+    hdr->__pad        = 0;
+    hdr->timestamp_ns = ktime_get_ns();
+    snap->size = sizeof(*hdr) + n * sizeof(*rec);
+}
+
+static int ram_bar_stats_open(struct inode *inode, struct file *file)
+{
+    struct ram_bar_snapshot *snap;
+
+    snap = kzalloc(sizeof(*snap) + ram_bar_stats_max(), GFP_KERNEL);
+    if (!snap)
+        return -ENOMEM;
+    mutex_init(&snap->lock);
+    file->private_data = snap;
+    return 0;
+}
+
+static ssize_t ram_bar_stats_read(struct file *file, char __user *buf, size_t count, loff_t *ppos)
+{
+    struct ram_bar_snapshot *snap = file->private_data;
+    ssize_t ret;
+
+    // Desde el principio: foto nueva. Si no, se sigue leyendo la misma foto.
+    mutex_lock(&snap->lock);
+    if (*ppos == 0)
+        ram_bar_fill(snap);
+    ret = simple_read_from_buffer(buf, count, ppos, snap->data, snap->size);
+    mutex_unlock(&snap->lock);
+    return ret;
+}
+
+static int ram_bar_stats_release(struct inode *inode, struct file *file)
+{
+    kfree(file->private_data);
+    return 0;
+}
+
+static const struct proc_ops ram_bar_stats_ops = {
+    .proc_open    = ram_bar_stats_open,
+    .proc_read    = ram_bar_stats_read,
+    .proc_lseek   = default_llseek,
+    .proc_release = ram_bar_stats_release,
+};
+
+/*
+ * /dev/ram_watch: en vez de reabrir /proc/ram_bar o llamar a cpu_info en un
+ * bucle, el programa fija umbrales y se duerme en poll(). Un trabajo periódico
+ * mide RAM y CPU cada 'watch_ms' (solo mientras haya alguien mirando) y
+ * despierta únicamente a los que tengan un umbral cruzado hacia arriba.
+ */
+static unsigned int watch_ms = 250;
+module_param(watch_ms, uint, 0644);
+MODULE_PARM_DESC(watch_ms, "Cada cuántos milisegundos /dev/ram_watch mide RAM y CPU (10-10000)");
+
+struct ram_watcher {
+    struct list_head node;
+    wait_queue_head_t wq;
+    struct ram_watch_thresholds th;
+    u32 above;                  // Qué métricas estaban sobre su umbral en el muestreo anterior
+    struct ram_watch_event ev;  // Avisos pendientes (ev.events == 0: no hay)
+};
+
+static LIST_HEAD(ram_watchers);
+static DEFINE_SPINLOCK(ram_watch_lock);   // Protege la lista y los campos de cada ram_watcher
+static u64 watch_prev_busy, watch_prev_total;
+
+static void ram_watch_sample(struct work_struct *work);
+static DECLARE_DELAYED_WORK(ram_watch_work, ram_watch_sample);
+
+// Uso de CPU desde el muestreo anterior (x100), igual que cpu_info de la Clase 7
+static u32 ram_watch_cpu(void)
+{
+    u64 busy, total = 0, idle = 0, dtotal;
+    u32 usage = 0;
+    int cpu;
+
+    for_each_online_cpu(cpu) {
+        const struct kernel_cpustat *kcs = &kcpustat_cpu(cpu);
+
+        total += kcs->cpustat[CPUTIME_USER] + kcs->cpustat[CPUTIME_NICE] +
+                 kcs->cpustat[CPUTIME_SYSTEM] + kcs->cpustat[CPUTIME_IRQ] +
+                 kcs->cpustat[CPUTIME_SOFTIRQ] + kcs->cpustat[CPUTIME_STEAL] +
+                 kcs->cpustat[CPUTIME_IOWAIT] + kcs->cpustat[CPUTIME_IDLE];
+        idle += kcs->cpustat[CPUTIME_IDLE];
+    }
+    busy = total - idle;
+
+    dtotal = total - watch_prev_total;
+    if (watch_prev_total && dtotal)
+        usage = (u32)div64_u64((busy - watch_prev_busy) * 10000ULL, dtotal);
+    watch_prev_busy = busy;
+    watch_prev_total = total;
+    return usage;
+}
+
+// ¿Cruzó hacia arriba? Solo avisa al pasar de "debajo" a "encima", no mientras siga encima
+static u32 ram_watch_check(struct ram_watcher *w, u32 bit, u32 threshold, u32 value)
+{
+    u32 was_above = w->above & bit;
+
+    if (!threshold || value < threshold) {
+        w->above &= ~bit;
+        return 0;
+    }
+    w->above |= bit;
+    return was_above ? 0 : bit;
+}
+
+static void ram_watch_sample(struct work_struct *work)
+{
+    struct ram_watcher *w;
+    struct sysinfo si;
+    u32 mem, cpu, fired;
+    u64 now = ktime_get_ns();
+    bool more;
+
+    // 1. MEDIR (una vez para todos los que miran)
+    si_meminfo(&si);
+    mem = si.totalram ? (u32)div64_u64((u64)(si.totalram - si.freeram) * 10000ULL, si.totalram) : 0;
+    cpu = ram_watch_cpu();
+
+    // 2. REVISAR LOS UMBRALES DE CADA UNO Y DESPERTAR SOLO A QUIEN CORRESPONDA
+    spin_lock(&ram_watch_lock);
+    list_for_each_entry(w, &ram_watchers, node) {
+        fired  = ram_watch_check(w, RAM_WATCH_MEM, w->th.mem_used_x100, mem);
+        fired |= ram_watch_check(w, RAM_WATCH_CPU, w->th.cpu_x100, cpu);
+        if (!fired)
+            continue;
+        w->ev.events |= fired;
+        w->ev.mem_used_x100 = mem;
+        w->ev.cpu_x100 = cpu;
+        w->ev.timestamp_ns = now;
+        wake_up_interruptible_poll(&w->wq, EPOLLIN | EPOLLRDNORM);
+    }
+    more = !list_empty(&ram_watchers);
+    spin_unlock(&ram_watch_lock);
+
+    // 3. SEGUIR SOLO SI QUEDA ALGUIEN MIRANDO
+    if (more)
+        queue_delayed_work(system_power_efficient_wq, &ram_watch_work,
+                           msecs_to_jiffies(clamp_t(unsigned int, READ_ONCE(watch_ms), 10, 10000)));
+}
+
+static int ram_watch_open(struct inode *inode, struct file *file)
+{
+    struct ram_watcher *w;
+    bool first;
+
+    w = kzalloc(sizeof(*w), GFP_KERNEL);
+    if (!w)
+        return -ENOMEM;
+    init_waitqueue_head(&w->wq);
+
+    spin_lock(&ram_watch_lock);
+    first = list_empty(&ram_watchers);
+    list_add_tail(&w->node, &ram_watchers);
+    spin_unlock(&ram_watch_lock);
+
+    // El primero en abrir arranca el muestreo
+    if (first)
+        queue_delayed_work(system_power_efficient_wq, &ram_watch_work, 0);
+
+    file->private_data = w;
+    return 0;
+}
+
+// write(): fija los umbrales. Los que ya estén por encima avisan en el siguiente muestreo.
+static ssize_t ram_watch_write(struct file *file, const char __user *buf, size_t count, loff_t *ppos)
+{
+    struct ram_watcher *w = file->private_data;
+    struct ram_watch_thresholds th;
+
+    if (count != sizeof(th))
+        return -EINVAL;
+    if (copy_from_user(&th, buf, sizeof(th)))
+        return -EFAULT;
+    if (th.mem_used_x100 > 10000 || th.cpu_x100 > 10000)
+        return -EINVAL;
+
+    spin_lock(&ram_watch_lock);
+    w->th = th;
+    w->above = 0;
+    spin_unlock(&ram_watch_lock);
+    return count;
+}
+
+// read(): entrega (y borra) los avisos pendientes. Sin avisos duerme, o -EAGAIN con O_NONBLOCK.
+static ssize_t ram_watch_read(struct file *file, char __user *buf, size_t count, loff_t *ppos)
+{
+    struct ram_watcher *w = file->private_data;
+    struct ram_watch_event ev;
+    int ret;
+
+    if (count < sizeof(ev))
+        return -EINVAL;
+
+    spin_lock(&ram_watch_lock);
+    while (!w->ev.events) {
+        spin_unlock(&ram_watch_lock);
+        if (file->f_flags & O_NONBLOCK)
+            return -EAGAIN;
+        ret = wait_event_interruptible(w->wq, READ_ONCE(w->ev.events));
+        if (ret)
+            return ret;
+        spin_lock(&ram_watch_lock);
+    }
+    ev = w->ev;
+    memset(&w->ev, 0, sizeof(w->ev));
+    spin_unlock(&ram_watch_lock);
+
+    if (copy_to_user(buf, &ev, sizeof(ev)))
+        return -EFAULT;
+    return sizeof(ev);
+}
+
+static __poll_t ram_watch_poll(struct file *file, poll_table *wait)
+{
+    struct ram_watcher *w = file->private_data;
+
+    poll_wait(file, &w->wq, wait);
+    return READ_ONCE(w->ev.events) ? EPOLLIN | EPOLLRDNORM : 0;
+}
+
+static int ram_watch_release(struct inode *inode, struct file *file)
+{
+    struct ram_watcher *w = file->private_data;
+
+    // Al quedar la lista vacía, el trabajo deja de reprogramarse solo
+    spin_lock(&ram_watch_lock);
+    list_del(&w->node);
+    spin_unlock(&ram_watch_lock);
+    kfree(w);
+    return 0;
+}
+
+static const struct file_operations ram_watch_fops = {
+    .owner   = THIS_MODULE,
+    .open    = ram_watch_open,
+    .read    = ram_watch_read,
+    .write   = ram_watch_write,
+    .poll    = ram_watch_poll,
+    .release = ram_watch_release,
+    .llseek  = noop_llseek,
+};
+
+static struct miscdevice ram_watch_dev = {
+    .minor = MISC_DYNAMIC_MINOR,
+    .name  = "ram_watch",
+    .fops  = &ram_watch_fops,
+    .mode  = 0666,
+};
+
 static int __init ram_bar_init(void)
 {
+    int ret;
+
+    ret = misc_register(&ram_watch_dev);
+    if (ret)
+        return ret;
     proc_create("ram_bar", 0, NULL, &ram_bar_ops);
+    proc_create("ram_bar_stats", 0444, NULL, &ram_bar_stats_ops);
     printk(KERN_INFO "Modulo ram_bar cargado.\n");
     return 0;
 }
 
 static void __exit ram_bar_exit(void)
 {
+    // Mientras el módulo está en uso no se puede descargar, así que ya no hay observadores
+    misc_deregister(&ram_watch_dev);
+    cancel_delayed_work_sync(&ram_watch_work);
+    remove_proc_entry("ram_bar_stats", NULL);
     remove_proc_entry("ram_bar", NULL);
     printk(KERN_INFO "Modulo ram_bar eliminado.\n");
 }
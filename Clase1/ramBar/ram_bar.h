@@ -0,0 +1,68 @@
+/*
+ * ram_bar.h
+ * Formato binario de /proc/ram_bar_stats.
+ * Lo incluyen el módulo y los recolectores en espacio de usuario:
+ * los números se leen tal cual, sin formatear ni parsear texto.
+ *
+ * Contenido del archivo:
+ *   struct ram_bar_header
+ *   struct ram_bar_record  x nr_records   (primero el sistema, después un registro por nodo NUMA)
+ */
+#ifndef _RAM_BAR_H
+#define _RAM_BAR_H
+
+#include <linux/types.h>
+
+#define RAM_BAR_STATS_PROC    "/proc/ram_bar_stats"
+#define RAM_BAR_STATS_VERSION 1
+
+/* Tipo de registro */
+#define RAM_BAR_REC_SYSTEM 1  /* Todo el sistema (si_meminfo) */
+#define RAM_BAR_REC_NODE   2  /* Un nodo NUMA (suma de sus zonas) */
+
+struct ram_bar_header {
+	__u32 version;      /* RAM_BAR_STATS_VERSION */
+	__u32 nr_records;   /* Registros que siguen a la cabecera */
+	__u32 record_size;  /* sizeof(struct ram_bar_record) del kernel */
+	__u32 __pad;
+	__u64 timestamp_ns; /* CLOCK_MONOTONIC en que se tomaron los datos */
+};
+
+/* Todos los valores en bytes. Lo que no existe por nodo (shared, buffer, swap) va en 0. */
+struct ram_bar_record {
+	__u32 type;         /* RAM_BAR_REC_SYSTEM o RAM_BAR_REC_NODE */
+	__s32 node;         /* Número de nodo (-1 para el sistema) */
+	__u64 total;
+	__u64 free;
+	__u64 used;         /* total - free */
+	__u64 shared;
+	__u64 buffer;
+	__u64 swap_free;    /* El total no va: si_swapinfo no está exportado a módulos (ver SwapTotal en /proc/meminfo) */
+};
+
+/*
+ * /dev/ram_watch: avisos por poll()/epoll cuando se cruza un umbral.
+ * Los umbrales se fijan con write() de una struct ram_watch_thresholds;
+ * read() devuelve una struct ram_watch_event (bloquea hasta que haya una,
+ * salvo con O_NONBLOCK).
+ */
+#define RAM_WATCH_DEVICE "/dev/ram_watch"
+
+/* Bits de ram_watch_event.events */
+#define RAM_WATCH_MEM 0x1  /* El uso de RAM cruzó su umbral hacia arriba */
+#define RAM_WATCH_CPU 0x2  /* El uso de CPU cruzó su umbral hacia arriba */
+
+struct ram_watch_thresholds {
+	__u32 mem_used_x100; /* % de RAM usada x100 (0 = sin umbral) */
+	__u32 cpu_x100;      /* % de CPU x100 (0 = sin umbral) */
+};
+
+struct ram_watch_event {
+	__u32 events;        /* RAM_WATCH_MEM | RAM_WATCH_CPU */
+	__u32 mem_used_x100; /* Valores del muestreo que disparó el aviso */
+	__u32 cpu_x100;
+	__u32 __pad;
+	__u64 timestamp_ns;  /* CLOCK_MONOTONIC del muestreo */
+};
+
+#endif /* _RAM_BAR_H */
@@ -0,0 +1,182 @@
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/miscdevice.h>   // /dev/telemetry sin tener que reservar un número mayor
+#include <linux/fs.h>
+#include <linux/mm.h>           // si_meminfo, vm_insert_page
+#include <linux/gfp.h>
+#include <linux/workqueue.h>    // delayed_work: la página se actualiza en segundo plano
+#include <linux/kernel_stat.h>  // kcpustat_cpu()
+#include <linux/cpumask.h>
+#include <linux/timekeeping.h>  // ktime_get_ns, ktime_get_boottime_seconds
+#include <linux/math64.h>
+
+#include "telemetry.h"
+
+/*
+    ¿Por qué una página compartida?
+    Cada métrica del proyecto cuesta una syscall (cpu_info, uptime_syscall) o
+    abrir /proc/ram_bar y formatear texto. Aquí el módulo escribe CPU, RAM y
+    uptime en UNA página de memoria cada 'interval_ms', y los programas la
+    mapean con mmap en modo solo lectura. Leer una métrica es leer memoria:
+    cero syscalls, como hace el vDSO con clock_gettime().
+*/
+
+static unsigned int interval_ms = 100;
+module_param(interval_ms, uint, 0644);
+MODULE_PARM_DESC(interval_ms, "Cada cuántos milisegundos se actualiza la página (10-10000)");
+
+static struct telemetry_page *page_data;   // La página compartida (dirección del kernel)
+static u64 prev_busy, prev_total;          // Totales de CPU del intervalo anterior
+
+static void telemetry_update(struct work_struct *work);
+static DECLARE_DELAYED_WORK(telemetry_work, telemetry_update);
+
+// Suma los contadores de todos los núcleos en línea (como read_cpu_times de la Clase 7)
+static void read_cpu_totals(u64 cpu_ns[TELEMETRY_CPU_NR], u32 *nr_cpus)
+{
+    int cpu, i;
+
+    for (i = 0; i < TELEMETRY_CPU_NR; i++)
+        cpu_ns[i] = 0;
+    *nr_cpus = 0;
+
+    for_each_online_cpu(cpu) {
+        const struct kernel_cpustat *kcs = &kcpustat_cpu(cpu);
+
+        cpu_ns[TELEMETRY_CPU_USER]    += kcs->cpustat[CPUTIME_USER];
+        cpu_ns[TELEMETRY_CPU_NICE]    += kcs->cpustat[CPUTIME_NICE];
+        cpu_ns[TELEMETRY_CPU_SYSTEM]  += kcs->cpustat[CPUTIME_SYSTEM];
+        cpu_ns[TELEMETRY_CPU_IRQ]     += kcs->cpustat[CPUTIME_IRQ];
+        cpu_ns[TELEMETRY_CPU_SOFTIRQ] += kcs->cpustat[CPUTIME_SOFTIRQ];
+        cpu_ns[TELEMETRY_CPU_STEAL]   += kcs->cpustat[CPUTIME_STEAL];
+        cpu_ns[TELEMETRY_CPU_IOWAIT]  += kcs->cpustat[CPUTIME_IOWAIT];
+        cpu_ns[TELEMETRY_CPU_IDLE]    += kcs->cpustat[CPUTIME_IDLE];
+        (*nr_cpus)++;
+    }
+}
+
+/*
+ * Trabajo periódico: junta todas las métricas FUERA de la sección de
+ * escritura y después las publica en la página.
+ */
+static void telemetry_update(struct work_struct *work)
+{
+    struct telemetry_page *p = page_data;
+    u64 cpu_ns[TELEMETRY_CPU_NR];
+    u64 busy, total = 0, dbusy, dtotal;
+    u32 nr_cpus, usage = 0, seq;
+    unsigned int ms;
+    struct sysinfo si;
+    int i;
+
+    // 1. LEER LAS MÉTRICAS
+    read_cpu_totals(cpu_ns, &nr_cpus);
+    for (i = 0; i < TELEMETRY_CPU_NR; i++)
+        total += cpu_ns[i];
+    busy = total - cpu_ns[TELEMETRY_CPU_IDLE];
+
+    dbusy = busy - prev_busy;
+    dtotal = total - prev_total;
+    if (prev_total && dtotal)
+        usage = (u32)div64_u64(dbusy * 10000ULL, dtotal);
+    prev_busy = busy;
+    prev_total = total;
+
+    si_meminfo(&si);
+    ms = clamp_t(unsigned int, READ_ONCE(interval_ms), 10, 10000);
+
+    // 2. PUBLICAR: seq impar = "escribiendo", los lectores reintentan
+    seq = p->seq;
+    WRITE_ONCE(p->seq, seq + 1);
+    smp_wmb(); // El seq impar se ve ANTES que cualquier dato nuevo
+
+    p->update_ns = ktime_get_ns();
+    p->interval_ms = ms;
+    p->nr_cpus = nr_cpus;
+    for (i = 0; i < TELEMETRY_CPU_NR; i++)
+        p->cpu_ns[i] = cpu_ns[i];
+    p->cpu_usage_x100 = usage;
+    p->mem_total  = (u64)si.totalram  * si.mem_unit;
+    p->mem_free   = (u64)si.freeram   * si.mem_unit;
+    p->mem_shared = (u64)si.sharedram * si.mem_unit;
+    p->mem_buffer = (u64)si.bufferram * si.mem_unit;
+    p->boottime_sec = ktime_get_boottime_seconds();
+
+    smp_wmb(); // Todos los datos se ven ANTES que el seq par
+    WRITE_ONCE(p->seq, seq + 2);
+
+    // 3. SIGUIENTE ACTUALIZACIÓN (el parámetro se relee en cada vuelta)
+    queue_delayed_work(system_power_efficient_wq, &telemetry_work, msecs_to_jiffies(ms));
+}
+
+/*
+ * mmap: mapea la página en el proceso. Solo lectura: si se pide escritura
+ * se rechaza, y se quita VM_MAYWRITE para que mprotect() tampoco pueda darla.
+ */
+static int telemetry_mmap(struct file *file, struct vm_area_struct *vma)
+{
+    if (vma->vm_pgoff != 0 || vma->vm_end - vma->vm_start != PAGE_SIZE)
+        return -EINVAL;
+    if (vma->vm_flags & VM_WRITE)
+        return -EPERM;
+
+    vm_flags_clear(vma, VM_MAYWRITE);
+    return vm_insert_page(vma, vma->vm_start, virt_to_page(page_data));
+}
+
+static const struct file_operations telemetry_fops = {
+    .owner = THIS_MODULE,
+    .mmap  = telemetry_mmap,
+};
+
+static struct miscdevice telemetry_dev = {
+    .minor = MISC_DYNAMIC_MINOR,
+    .name  = "telemetry",
+    .fops  = &telemetry_fops,
+    .mode  = 0444, // Cualquiera puede leer
+};
+
+static int __init telemetry_init(void)
+{
+    int ret;
+
+    // Una página completa en cero: mmap trabaja con páginas, no con kmalloc
+    page_data = (struct telemetry_page *)get_zeroed_page(GFP_KERNEL);
+    if (!page_data)
+        return -ENOMEM;
+    page_data->version = TELEMETRY_VERSION;
+
+    // Primera actualización antes de registrar el dispositivo: nadie ve la página vacía
+    telemetry_update(NULL);
+
+    ret = misc_register(&telemetry_dev);
+    if (ret) {
+        cancel_delayed_work_sync(&telemetry_work);
+        free_page((unsigned long)page_data);
+        return ret;
+    }
+
+    printk(KERN_INFO "Modulo telemetry cargado (%s).\n", TELEMETRY_DEVICE);
+    return 0;
+}
+
+static void __exit telemetry_exit(void)
+{
+    /*
+     * misc_deregister primero: ya no se puede abrir. Los procesos que todavía
+     * tengan la página mapeada conservan una referencia propia (vm_insert_page),
+     * así que free_page solo suelta la nuestra.
+     */
+    misc_deregister(&telemetry_dev);
+    cancel_delayed_work_sync(&telemetry_work);
+    free_page((unsigned long)page_data);
+    printk(KERN_INFO "Modulo telemetry eliminado.\n");
+}
+
+module_init(telemetry_init);
+module_exit(telemetry_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_AUTHOR("SOPES2");
+MODULE_DESCRIPTION("Página compartida (mmap) con métricas de CPU, RAM y uptime");
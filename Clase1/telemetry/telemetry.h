@@ -0,0 +1,56 @@
+/*
+ * telemetry.h
+ * Formato de la página compartida de /dev/telemetry.
+ * Lo incluyen tanto el módulo (telemetry.c) como los programas de usuario
+ * (telemetry_reader.h): los dos ven exactamente la misma estructura.
+ */
+#ifndef _TELEMETRY_H
+#define _TELEMETRY_H
+
+#include <linux/types.h>
+
+#define TELEMETRY_DEVICE  "/dev/telemetry"
+#define TELEMETRY_VERSION 1
+
+/* Estados de CPU, en el orden de /proc/stat */
+enum telemetry_cpu_state {
+	TELEMETRY_CPU_USER,
+	TELEMETRY_CPU_NICE,
+	TELEMETRY_CPU_SYSTEM,
+	TELEMETRY_CPU_IRQ,
+	TELEMETRY_CPU_SOFTIRQ,
+	TELEMETRY_CPU_STEAL,
+	TELEMETRY_CPU_IOWAIT,
+	TELEMETRY_CPU_IDLE,
+	TELEMETRY_CPU_NR,
+};
+
+/*
+ * La página completa. 'seq' funciona como un seqlock manual (igual que el vDSO):
+ * es impar mientras el módulo escribe y par cuando los datos están completos.
+ * Un lector copia los campos y solo acepta la copia si 'seq' era par y no
+ * cambió entre el principio y el final.
+ */
+struct telemetry_page {
+	__u32 seq;
+	__u32 version;                  /* TELEMETRY_VERSION */
+	__u64 update_ns;                /* CLOCK_MONOTONIC de la última actualización */
+	__u32 interval_ms;              /* Cada cuánto se actualiza la página */
+	__u32 nr_cpus;                  /* Núcleos en línea */
+
+	/* CPU */
+	__u64 cpu_ns[TELEMETRY_CPU_NR]; /* Tiempo acumulado de todos los núcleos en cada estado */
+	__u32 cpu_usage_x100;           /* Uso de CPU del último intervalo x100 (10000 = 100.00%) */
+	__u32 __pad;
+
+	/* RAM (bytes, de si_meminfo) */
+	__u64 mem_total;
+	__u64 mem_free;
+	__u64 mem_shared;
+	__u64 mem_buffer;
+
+	/* Tiempo desde el arranque (incluye suspensión, como uptime_syscall) */
+	__u64 boottime_sec;
+};
+
+#endif /* _TELEMETRY_H */
@@ -0,0 +1,112 @@
+/*
+ * Benchmark: leer las métricas desde /dev/telemetry contra las interfaces anteriores.
+ *   - syscall 551 (cpu_info)       -> uso de CPU
+ *   - syscall 550 (uptime_syscall) -> segundos desde el arranque
+ *   - /proc/ram_bar                -> open + read + close + parsear el porcentaje
+ *   - telemetry_read()             -> las tres cosas juntas, sin syscalls
+ *
+ * Compilar: make bench   (o gcc -O2 -o telemetry_bench telemetry_bench.c)
+ * Ejecutar: ./telemetry_bench [iteraciones]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include "telemetry_reader.h"
+
+#define SYS_CPU_USAGE 551
+#define SYS_UPTIME    550
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void report(const char *name, long iters, double dt, long errors) {
+    if (errors == iters)
+        printf("%-22s %12s\n", name, "no disponible");
+    else
+        printf("%-22s %12.0f %14.0f\n", name, dt / iters * 1e9, iters / dt);
+}
+
+int main(int argc, char **argv) {
+    long iters = argc > 1 ? strtol(argv[1], NULL, 10) : 100000;
+    volatile long sink = 0;
+    long errors;
+    double t0;
+    char buf[128];
+
+    printf("%-22s %12s %14s\n", "interfaz", "ns/lectura", "lecturas/s");
+
+    // 1. cpu_info
+    errors = 0;
+    t0 = now_sec();
+    for (long i = 0; i < iters; i++) {
+        int cpu = 0;
+        if (syscall(SYS_CPU_USAGE, &cpu) != 0)
+            errors++;
+        sink += cpu;
+    }
+    report("syscall cpu_info", iters, now_sec() - t0, errors);
+
+    // 2. uptime_syscall
+    errors = 0;
+    t0 = now_sec();
+    for (long i = 0; i < iters; i++) {
+        long up = syscall(SYS_UPTIME);
+        if (up < 0)
+            errors++;
+        sink += up;
+    }
+    report("syscall uptime", iters, now_sec() - t0, errors);
+
+    // 3. /proc/ram_bar: abrir, leer el texto y sacar el número
+    errors = 0;
+    t0 = now_sec();
+    for (long i = 0; i < iters; i++) {
+        int fd = open("/proc/ram_bar", O_RDONLY);
+        ssize_t n;
+        if (fd < 0) {
+            errors++;
+            continue;
+        }
+        n = read(fd, buf, sizeof(buf) - 1);
+        close(fd);
+        if (n <= 0) {
+            errors++;
+            continue;
+        }
+        buf[n] = '\0';
+        char *p = strchr(buf, ']');
+        sink += p ? atoi(p + 1) : 0;
+    }
+    report("/proc/ram_bar", iters, now_sec() - t0, errors);
+
+    // 4. Página compartida: CPU, RAM y uptime en una sola copia
+    const struct telemetry_page *page = telemetry_open();
+    if (!page) {
+        perror("No se pudo mapear " TELEMETRY_DEVICE);
+        return 1;
+    }
+    struct telemetry_page snap;
+    telemetry_read(page, &snap);
+    t0 = now_sec();
+    for (long i = 0; i < iters; i++) {
+        telemetry_read(page, &snap);
+        sink += snap.cpu_usage_x100 + snap.mem_free + snap.boottime_sec;
+    }
+    report("telemetry (mmap)", iters, now_sec() - t0, 0);
+
+    printf("\nCPU %u.%02u%%  RAM libre %llu MiB de %llu MiB  uptime %llu s  (actualizada cada %u ms)\n",
+           snap.cpu_usage_x100 / 100, snap.cpu_usage_x100 % 100,
+           (unsigned long long)(snap.mem_free >> 20), (unsigned long long)(snap.mem_total >> 20),
+           (unsigned long long)snap.boottime_sec, snap.interval_ms);
+
+    telemetry_close(page);
+    return 0;
+}
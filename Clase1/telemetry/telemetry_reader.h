@@ -0,0 +1,67 @@
+/*
+ * telemetry_reader.h
+ * Biblioteca mínima (solo cabecera) para leer /dev/telemetry desde espacio de usuario.
+ *
+ *   const struct telemetry_page *t = telemetry_open();
+ *   struct telemetry_page snap;
+ *   telemetry_read(t, &snap);   // Copia consistente, sin syscalls
+ *   telemetry_close(t);
+ */
+#ifndef _TELEMETRY_READER_H
+#define _TELEMETRY_READER_H
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "telemetry.h"
+
+// Mapea la página (solo lectura). Devuelve NULL si el módulo no está cargado.
+static inline const struct telemetry_page *telemetry_open(void)
+{
+    int fd = open(TELEMETRY_DEVICE, O_RDONLY);
+    void *p;
+
+    if (fd < 0)
+        return NULL;
+    p = mmap(NULL, sysconf(_SC_PAGESIZE), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd); // El mapeo sigue vivo sin el descriptor
+    if (p == MAP_FAILED)
+        return NULL;
+    if (((const struct telemetry_page *)p)->version != TELEMETRY_VERSION) {
+        munmap(p, sysconf(_SC_PAGESIZE));
+        return NULL;
+    }
+    return (const struct telemetry_page *)p;
+}
+
+static inline void telemetry_close(const struct telemetry_page *page)
+{
+    if (page)
+        munmap((void *)page, sysconf(_SC_PAGESIZE));
+}
+
+/*
+ * Copia la página completa en 'out' de forma consistente.
+ * Si el módulo la está actualizando (seq impar) o la actualizó mientras
+ * copiábamos (seq cambió), se vuelve a intentar. Devuelve 'out'.
+ */
+static inline struct telemetry_page *telemetry_read(const struct telemetry_page *page,
+                                                    struct telemetry_page *out)
+{
+    __u32 start;
+
+    for (;;) {
+        start = __atomic_load_n(&page->seq, __ATOMIC_ACQUIRE);
+        if (start & 1)
+            continue;
+        memcpy(out, (const void *)page, sizeof(*out));
+        // Los datos copiados deben leerse ANTES que el seq final
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&page->seq, __ATOMIC_RELAXED) == start)
+            return out;
+    }
+}
+
+#endif /* _TELEMETRY_READER_H */
@@ -1,38 +1,612 @@
 #include "crow.h"
 #include <unistd.h>
 #include <sys/syscall.h>
+#include <sys/sysinfo.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "../Clase7/linux-6.12.61/include/uapi/linux/cpu_usage.h"
 
 // Definición de tu syscall
 #define SYS_CPU_USAGE 551
+#define SYS_CPU_USAGE_STATS 557
+
+// Lee un entero de una variable de entorno (o usa el valor por defecto)
+static long env_or(const char* name, long def) {
+    const char* v = std::getenv(name);
+    return v && *v ? std::strtol(v, nullptr, 10) : def;
+}
+
+// Campos de CPU en JSON (los mismos que devolvía crow::json::wvalue en /stats)
+static int format_cpu_fields(char* out, size_t size, int cpu_usage) {
+    return std::snprintf(out, size,
+        "\"cpu_usage_percent\":%.2f,\"cpu_idle_percent\":%.2f,\"raw_value\":%d",
+        cpu_usage / 100.0, 100.0 - cpu_usage / 100.0, cpu_usage);
+}
+
+/*
+ * Caché de /stats con una sola muestra en vuelo (single-flight)
+ * Con multithreaded() cada petición simultánea hacía su propia syscall.
+ * Ahora:
+ *   - Si la última muestra tiene menos de STATS_TTL_MS (por defecto 100), se
+ *     devuelve tal cual: el JSON ya está armado y es inmutable.
+ *   - Si venció, UN hilo toma la muestra nueva y el resto espera ese mismo
+ *     resultado en vez de llamar al kernel otra vez.
+ * La instantánea se publica cambiando un shared_ptr de forma atómica: los
+ * lectores del camino rápido no toman ningún lock.
+ */
+struct StatsSnapshot {
+    bool ok;
+    std::string json;
+    std::chrono::steady_clock::time_point taken;
+};
+
+struct StatsCache {
+    std::chrono::milliseconds ttl{env_or("STATS_TTL_MS", 100)};
+
+    std::shared_ptr<const StatsSnapshot> current; // Solo con std::atomic_load/atomic_store
+    std::mutex mtx;                               // Protege 'in_flight'
+    std::condition_variable cv;
+    bool in_flight = false;
+
+    bool fresh(const std::shared_ptr<const StatsSnapshot>& snap) const {
+        return snap && std::chrono::steady_clock::now() - snap->taken < ttl;
+    }
+
+    std::shared_ptr<const StatsSnapshot> get() {
+        // 1. CAMINO RÁPIDO: la instantánea vigente, sin locks
+        auto snap = std::atomic_load(&current);
+        if (fresh(snap))
+            return snap;
+
+        // 2. ¿YA HAY ALGUIEN MUESTREANDO? Esperamos su resultado
+        std::unique_lock<std::mutex> lock(mtx);
+        snap = std::atomic_load(&current);
+        if (fresh(snap))
+            return snap;
+        if (in_flight) {
+            cv.wait(lock, [this] { return !in_flight; });
+            return std::atomic_load(&current);
+        }
+        in_flight = true;
+        lock.unlock();
+
+        // 3. SOMOS LOS ÚNICOS: muestra y JSON una sola vez, fuera del lock
+        auto next = std::make_shared<StatsSnapshot>();
+        int cpu_usage = 0;
+        next->ok = syscall(SYS_CPU_USAGE, &cpu_usage) == 0;
+        if (next->ok) {
+            char body[128];
+            int len = format_cpu_fields(body + 1, sizeof(body) - 2, cpu_usage);
+            body[0] = '{';
+            body[len + 1] = '}';
+            next->json.assign(body, len + 2);
+        }
+        next->taken = std::chrono::steady_clock::now();
+        snap = next;
+
+        // 4. PUBLICAR Y DESPERTAR A LOS QUE ESPERABAN
+        lock.lock();
+        std::atomic_store(&current, snap);
+        in_flight = false;
+        lock.unlock();
+        cv.notify_all();
+        return snap;
+    }
+};
+
+/*
+ * Streaming por WebSocket (/stats/ws)
+ * Antes cada dashboard hacía polling a /stats: N clientes = N muestras del kernel.
+ * Ahora un solo hilo toma UNA muestra por tick, arma el JSON UNA vez y envía
+ * el mismo texto a todos los suscriptores. Por cliente solo cuesta copiar el buffer.
+ *
+ * Configuración (variables de entorno):
+ *   STATS_TICK_MS      cada cuántos ms se toma una muestra (por defecto 1000, mínimo 1)
+ *   STATS_MAX_CLIENTS  máximo de suscriptores simultáneos (por defecto 256)
+ *   STATS_MAX_LAG      frames sin confirmar que se toleran por cliente antes de
+ *                      saltarle frames (por defecto 8, mínimo 1). Siempre hay un
+ *                      tope: la cola de envío de Crow no tiene límite propio.
+ *
+ * Mensajes del cliente:
+ *   "every N"  recibir solo 1 de cada N frames (decimación)
+ *   "ack"      confirma el último frame recibido
+ */
+struct Subscriber {
+    unsigned every = 1;    // Decimación pedida por el cliente
+    unsigned unacked = 0;  // Frames enviados sin "ack"
+};
+
+struct StatsStream {
+    // Con tick 0 el bucle giraría sin dormir
+    std::chrono::milliseconds tick{std::max(env_or("STATS_TICK_MS", 1000), 1L)};
+    size_t max_clients = env_or("STATS_MAX_CLIENTS", 256);
+    unsigned max_lag = std::clamp(env_or("STATS_MAX_LAG", 8), 1L, 1L << 20);
+
+    std::mutex mtx; // Protege 'subs' (los callbacks de Crow corren en sus propios hilos)
+    std::unordered_map<crow::websocket::connection*, Subscriber> subs;
+    std::atomic<unsigned long> seq{0};
+
+    // Una muestra + un JSON por tick, compartido por todos
+    void run() {
+        auto next = std::chrono::steady_clock::now();
+        for (;;) {
+            next += tick;
+            std::this_thread::sleep_until(next);
+
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                if (subs.empty())
+                    continue; // Nadie mirando: no se toca el kernel
+            }
+
+            int cpu_usage = 0;
+            if (syscall(SYS_CPU_USAGE, &cpu_usage) != 0)
+                continue;
+
+            unsigned long n = ++seq;
+            char frame[160];
+            int len = std::snprintf(frame, sizeof(frame), "{\"seq\":%lu,", n);
+            len += format_cpu_fields(frame + len, sizeof(frame) - len - 1, cpu_usage);
+            frame[len++] = '}';
+            const std::string text(frame, len);
+
+            std::lock_guard<std::mutex> lock(mtx);
+            for (auto& [conn, sub] : subs) {
+                if (n % sub.every != 0)
+                    continue;
+                // Cliente lento: tiene demasiados frames sin confirmar, se salta este
+                // (el cliente ve el salto en "seq")
+                if (sub.unacked >= max_lag)
+                    continue;
+                sub.unacked++;
+                conn->send_text(text); // Crow lo encola en el hilo de I/O de la conexión
+            }
+        }
+    }
+};
+
+/*
+ * Historial en memoria (/stats/range)
+ * Un hilo guarda una muestra de CPU, RAM y uptime cada STATS_HISTORY_RES_S
+ * segundos (por defecto 1) en anillos de tamaño fijo, y además promedia en
+ * dos niveles más gruesos (x10 y x60: 1 s, 10 s y 1 min por defecto).
+ * Las consultas leen solo memoria: no tocan el kernel.
+ *
+ * Cada muestra ocupa dos palabras de 64 bits, cada una atómica:
+ *   a = tiempo(32) | cpu_x100(16) | ram_x100(16)
+ *   b = tiempo(32) | uptime(32)
+ * Hay un solo escritor. Un lector que ve el mismo tiempo en las dos palabras
+ * tiene una muestra completa; si no, el escritor la estaba pisando y se salta.
+ * Así no hay locks ni del lado del escritor ni de los lectores.
+ */
+struct HistoryPoint {
+    uint32_t t;         // Segundos UNIX
+    uint16_t cpu_x100;  // 1500 = 15.00%
+    uint16_t ram_x100;  // RAM usada x100
+    uint32_t uptime;    // Segundos desde el arranque
+};
+
+class HistoryRing {
+public:
+    HistoryRing(unsigned res, size_t capacity) : res_(res), slots_(capacity) {}
+
+    unsigned resolution() const { return res_; }
+    size_t capacity() const { return slots_.size(); }
+
+    // Solo la llama el hilo del historial
+    void push(const HistoryPoint& p) {
+        uint64_t n = head_.load(std::memory_order_relaxed);
+        Slot& slot = slots_[n % slots_.size()];
+        slot.b.store((uint64_t)p.t << 32 | p.uptime, std::memory_order_relaxed);
+        slot.a.store((uint64_t)p.t << 32 | (uint32_t)p.cpu_x100 << 16 | p.ram_x100, std::memory_order_release);
+        head_.store(n + 1, std::memory_order_release);
+    }
+
+    // Tiempo de la muestra más vieja que todavía está en el anillo (0 si está vacío)
+    uint32_t oldest() const {
+        uint64_t n = head_.load(std::memory_order_acquire);
+        if (n == 0)
+            return 0;
+        uint64_t first = n > slots_.size() ? n - slots_.size() : 0;
+        return slots_[first % slots_.size()].a.load(std::memory_order_acquire) >> 32;
+    }
+
+    // Llama a fn(punto) para cada muestra con from <= t <= to, de la más vieja a la más nueva
+    template <class Fn>
+    void scan(uint32_t from, uint32_t to, Fn fn) const {
+        uint64_t n = head_.load(std::memory_order_acquire);
+        uint64_t first = n > slots_.size() ? n - slots_.size() : 0;
+        for (uint64_t i = first; i < n; i++) {
+            const Slot& slot = slots_[i % slots_.size()];
+            uint64_t a = slot.a.load(std::memory_order_acquire);
+            uint64_t b = slot.b.load(std::memory_order_relaxed);
+            uint32_t t = a >> 32;
+            if (t != (b >> 32) || t < from)
+                continue; // Pisada a medias, o fuera del rango
+            if (t > to)
+                break;
+            fn(HistoryPoint{t, (uint16_t)(a >> 16), (uint16_t)a, (uint32_t)b});
+        }
+    }
+
+private:
+    struct Slot {
+        std::atomic<uint64_t> a{0};
+        std::atomic<uint64_t> b{0};
+    };
+    unsigned res_;
+    std::vector<Slot> slots_;
+    std::atomic<uint64_t> head_{0}; // Cantidad total de muestras escritas
+};
+
+// Acumula muestras finas para producir un punto del nivel siguiente (promedio)
+struct HistoryBucket {
+    uint64_t cpu = 0, ram = 0;
+    uint32_t start = 0;
+    unsigned count = 0;
+
+    // Devuelve true (y el promedio en 'out', con el tiempo de la primera muestra) al juntar 'every'
+    bool add(const HistoryPoint& p, unsigned every, HistoryPoint& out) {
+        if (count == 0)
+            start = p.t;
+        cpu += p.cpu_x100;
+        ram += p.ram_x100;
+        if (++count < every)
+            return false;
+        out = HistoryPoint{start, (uint16_t)(cpu / count), (uint16_t)(ram / count), p.uptime};
+        cpu = ram = count = 0;
+        return true;
+    }
+};
+
+struct StatsHistory {
+    unsigned res = std::max(1L, env_or("STATS_HISTORY_RES_S", 1));
+    // Capacidades por defecto: 1 hora a 1 s, 1 día a 10 s, 1 semana a 1 min
+    HistoryRing tiers[3] = {
+        HistoryRing(res,      std::max(1L, env_or("STATS_HISTORY_FINE", 3600))),
+        HistoryRing(res * 10, std::max(1L, env_or("STATS_HISTORY_MID", 8640))),
+        HistoryRing(res * 60, std::max(1L, env_or("STATS_HISTORY_COARSE", 10080))),
+    };
+
+    void run() {
+        HistoryBucket mid, coarse;
+        HistoryPoint avg;
+        auto next = std::chrono::steady_clock::now();
+        for (;;) {
+            next += std::chrono::seconds(res);
+            std::this_thread::sleep_until(next);
+
+            int cpu_usage = 0;
+            struct sysinfo si;
+            if (syscall(SYS_CPU_USAGE, &cpu_usage) != 0 || sysinfo(&si) != 0)
+                continue;
+
+            HistoryPoint p;
+            p.t = (uint32_t)std::time(nullptr);
+            p.cpu_x100 = (uint16_t)cpu_usage;
+            p.ram_x100 = si.totalram ? (uint16_t)((si.totalram - si.freeram) * 10000ULL / si.totalram) : 0;
+            p.uptime = (uint32_t)si.uptime;
+
+            tiers[0].push(p);
+            if (mid.add(p, 10, avg))
+                tiers[1].push(avg);
+            if (coarse.add(p, 60, avg))
+                tiers[2].push(avg);
+        }
+    }
+
+    /*
+     * Arma el JSON de /stats/range en 'out'.
+     * Usa el nivel más fino cuya resolución no supere 'step' y que todavía
+     * tenga datos desde 'from'; si step es mayor que esa resolución, promedia.
+     */
+    void range(uint32_t from, uint32_t to, uint32_t step, std::string& out) const {
+        const size_t max_points = 10000;
+        auto covers = [from](const HistoryRing& r) { return r.oldest() && r.oldest() <= from; };
+        const HistoryRing* ring = &tiers[0];
+        for (const HistoryRing& r : tiers) {
+            if (&r != &tiers[0] && r.resolution() > step)
+                break; // Más grueso que lo pedido
+            ring = &r;
+            if (covers(r))
+                break;
+        }
+        // Ningún nivel permitido llega tan atrás: el que llegue más lejos (el más fino si empatan)
+        if (!covers(*ring)) {
+            for (const HistoryRing& r : tiers) {
+                if (r.oldest() && (!ring->oldest() || r.oldest() < ring->oldest()))
+                    ring = &r;
+            }
+        }
+        step = std::max(step, ring->resolution());
+        // Nunca más de max_points puntos por respuesta
+        if ((to - from) / step > max_points)
+            step = (to - from) / max_points + 1;
+
+        char buf[96];
+        std::snprintf(buf, sizeof(buf), "{\"from\":%u,\"to\":%u,\"step\":%u,\"resolution\":%u,\"points\":[",
+                      from, to, step, ring->resolution());
+        out += buf;
+
+        // Promedio por cubeta de 'step' segundos: [t, cpu%, ram%, uptime]
+        uint64_t cpu = 0, ram = 0;
+        uint32_t bucket = 0, uptime = 0, count = 0;
+        bool first = true;
+        auto flush = [&]() {
+            if (!count)
+                return;
+            std::snprintf(buf, sizeof(buf), "%s[%u,%.2f,%.2f,%u]", first ? "" : ",",
+                          bucket, cpu / count / 100.0, ram / count / 100.0, uptime);
+            out += buf;
+            first = false;
+            cpu = ram = count = 0;
+        };
+        ring->scan(from, to, [&](const HistoryPoint& p) {
+            uint32_t b = from + (p.t - from) / step * step;
+            if (b != bucket)
+                flush();
+            bucket = b;
+            cpu += p.cpu_x100;
+            ram += p.ram_x100;
+            uptime = p.uptime;
+            count++;
+        });
+        flush();
+        out += "]}";
+    }
+};
+
+// Lee un parámetro numérico de la URL (o el valor por defecto)
+static uint32_t url_param(const crow::request& req, const char* name, uint32_t def) {
+    const char* v = req.url_params.get(name);
+    return v && *v ? (uint32_t)std::strtoul(v, nullptr, 10) : def;
+}
+
+/*
+ * Métricas del propio servicio para /metrics: peticiones y latencia por endpoint.
+ * Un middleware mide cada petición; todo son contadores atómicos (sin locks).
+ */
+enum Endpoint { EP_STATS, EP_RANGE, EP_METRICS, EP_OTHER, EP_COUNT };
+static const char* const endpoint_names[EP_COUNT] = {"/stats", "/stats/range", "/metrics", "other"};
+
+// Límites de las cubetas del histograma, en segundos
+static const double latency_bounds[] = {0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005,
+                                        0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1.0};
+static constexpr size_t NR_BOUNDS = sizeof(latency_bounds) / sizeof(latency_bounds[0]);
+
+struct EndpointMetrics {
+    std::atomic<uint64_t> requests{0};
+    std::atomic<uint64_t> errors{0};              // Respuestas con código >= 500
+    std::atomic<uint64_t> buckets[NR_BOUNDS + 1]; // La última es +Inf (cada una sin acumular)
+    std::atomic<uint64_t> sum_ns{0};
+};
+static EndpointMetrics endpoint_metrics[EP_COUNT];
+
+static Endpoint endpoint_of(const std::string& url) {
+    for (int i = 0; i < EP_OTHER; i++) {
+        if (url == endpoint_names[i])
+            return (Endpoint)i;
+    }
+    return EP_OTHER;
+}
+
+struct RequestMetrics {
+    struct context {
+        std::chrono::steady_clock::time_point start;
+    };
+
+    void before_handle(crow::request&, crow::response&, context& ctx) {
+        ctx.start = std::chrono::steady_clock::now();
+    }
+
+    void after_handle(crow::request& req, crow::response& res, context& ctx) {
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - ctx.start).count();
+        EndpointMetrics& m = endpoint_metrics[endpoint_of(req.url)];
+        double sec = ns / 1e9;
+        size_t b = 0;
+        while (b < NR_BOUNDS && sec > latency_bounds[b])
+            b++;
+        m.buckets[b].fetch_add(1, std::memory_order_relaxed);
+        m.sum_ns.fetch_add(ns, std::memory_order_relaxed);
+        m.requests.fetch_add(1, std::memory_order_relaxed);
+        if (res.code >= 500)
+            m.errors.fetch_add(1, std::memory_order_relaxed);
+    }
+};
+
+// Agrega texto con formato al final de 'out' (sin strings temporales)
+template <class... Args>
+static void appendf(std::string& out, const char* fmt, Args... args) {
+    char buf[256];
+    int len = std::snprintf(buf, sizeof(buf), fmt, args...);
+    out.append(buf, std::min<size_t>(len, sizeof(buf) - 1));
+}
+
+/*
+ * Arma /metrics en formato de texto de Prometheus dentro de 'out'.
+ * 'out' y 'cpus' son buffers del hilo que se reutilizan entre scrapes:
+ * después del primero ya tienen capacidad y no se vuelve a pedir memoria.
+ */
+static void render_metrics(std::string& out, std::vector<cpu_usage_stat>& cpus) {
+    static const char* const state_names[CPU_STATE_NR] = {
+        "user", "nice", "system", "irq", "softirq", "steal", "iowait", "idle"};
+
+    // 1. CPU TOTAL (syscall 551)
+    int cpu_usage = 0;
+    if (syscall(SYS_CPU_USAGE, &cpu_usage) == 0) {
+        out += "# HELP sopes_cpu_usage_ratio Uso de CPU del último muestreo del kernel.\n"
+               "# TYPE sopes_cpu_usage_ratio gauge\n";
+        appendf(out, "sopes_cpu_usage_ratio %.4f\n", cpu_usage / 10000.0);
+    }
+
+    // 2. TIEMPO POR ESTADO DE CADA NÚCLEO (syscall 557, una sola llamada)
+    if (cpus.empty())
+        cpus.resize(std::max(1L, sysconf(_SC_NPROCESSORS_CONF)));
+    struct cpu_usage_stats stats = {};
+    stats.version = CPU_USAGE_STATS_VERSION;
+    stats.nr_entries = cpus.size();
+    stats.entries = (uint64_t)(uintptr_t)cpus.data();
+    if (syscall(SYS_CPU_USAGE_STATS, &stats) >= 0) {
+        out += "# HELP sopes_cpu_state_seconds Segundos en cada estado durante la última ventana de muestreo.\n"
+               "# TYPE sopes_cpu_state_seconds gauge\n";
+        for (unsigned i = 0; i < stats.nr_entries; i++) {
+            for (int st = 0; st < CPU_STATE_NR; st++)
+                appendf(out, "sopes_cpu_state_seconds{cpu=\"%u\",state=\"%s\"} %.6f\n",
+                        cpus[i].cpu, state_names[st], cpus[i].delta[st] / 1e9);
+        }
+        out += "# HELP sopes_cpu_window_seconds Largo de la ventana de muestreo.\n"
+               "# TYPE sopes_cpu_window_seconds gauge\n";
+        appendf(out, "sopes_cpu_window_seconds %.3f\n", stats.window_ms / 1000.0);
+    }
+
+    // 3. RAM Y UPTIME (sysinfo)
+    struct sysinfo si;
+    if (sysinfo(&si) == 0) {
+        out += "# HELP sopes_memory_total_bytes RAM total.\n"
+               "# TYPE sopes_memory_total_bytes gauge\n";
+        appendf(out, "sopes_memory_total_bytes %llu\n", (unsigned long long)si.totalram * si.mem_unit);
+        out += "# HELP sopes_memory_free_bytes RAM libre.\n"
+               "# TYPE sopes_memory_free_bytes gauge\n";
+        appendf(out, "sopes_memory_free_bytes %llu\n", (unsigned long long)si.freeram * si.mem_unit);
+        out += "# HELP sopes_uptime_seconds Segundos desde el arranque.\n"
+               "# TYPE sopes_uptime_seconds gauge\n";
+        appendf(out, "sopes_uptime_seconds %ld\n", si.uptime);
+    }
+
+    // 4. EL PROPIO SERVICIO
+    out += "# HELP sopes_http_requests_total Peticiones atendidas por endpoint.\n"
+           "# TYPE sopes_http_requests_total counter\n";
+    for (int e = 0; e < EP_COUNT; e++)
+        appendf(out, "sopes_http_requests_total{endpoint=\"%s\"} %llu\n", endpoint_names[e],
+                (unsigned long long)endpoint_metrics[e].requests.load(std::memory_order_relaxed));
+    out += "# HELP sopes_http_errors_total Respuestas 5xx por endpoint.\n"
+           "# TYPE sopes_http_errors_total counter\n";
+    for (int e = 0; e < EP_COUNT; e++)
+        appendf(out, "sopes_http_errors_total{endpoint=\"%s\"} %llu\n", endpoint_names[e],
+                (unsigned long long)endpoint_metrics[e].errors.load(std::memory_order_relaxed));
+
+    out += "# HELP sopes_http_request_duration_seconds Latencia de las peticiones por endpoint.\n"
+           "# TYPE sopes_http_request_duration_seconds histogram\n";
+    for (int e = 0; e < EP_COUNT; e++) {
+        const EndpointMetrics& m = endpoint_metrics[e];
+        uint64_t cumulative = 0;
+        for (size_t b = 0; b <= NR_BOUNDS; b++) {
+            cumulative += m.buckets[b].load(std::memory_order_relaxed);
+            if (b < NR_BOUNDS)
+                appendf(out, "sopes_http_request_duration_seconds_bucket{endpoint=\"%s\",le=\"%g\"} %llu\n",
+                        endpoint_names[e], latency_bounds[b], (unsigned long long)cumulative);
+            else
+                appendf(out, "sopes_http_request_duration_seconds_bucket{endpoint=\"%s\",le=\"+Inf\"} %llu\n",
+                        endpoint_names[e], (unsigned long long)cumulative);
+        }
+        appendf(out, "sopes_http_request_duration_seconds_sum{endpoint=\"%s\"} %.6f\n",
+                endpoint_names[e], m.sum_ns.load(std::memory_order_relaxed) / 1e9);
+        appendf(out, "sopes_http_request_duration_seconds_count{endpoint=\"%s\"} %llu\n",
+                endpoint_names[e], (unsigned long long)cumulative);
+    }
+}
 
 int main() {
-    crow::SimpleApp app;
+    crow::App<RequestMetrics> app;
+    static StatsCache cache;
+    static StatsStream stream;
+    static StatsHistory history;
 
-    // Endpoint: /stats
+    // Endpoint: /stats (servido desde la caché compartida por todos los hilos)
     CROW_ROUTE(app, "/stats")([](){
-        int cpu_usage = 0;
-        
-        // Ejecutamos la syscall
-        long res = syscall(SYS_CPU_USAGE, &cpu_usage);
+        auto snap = cache.get();
 
-        if (res != 0) {
+        if (!snap || !snap->ok) {
             // Si la syscall falla, devolvemos un error 500
             return crow::response(500, "Error al ejecutar la syscall");
         }
 
-        // Cálculos
-        // Suponiendo que cpu_usage viene en formato XXXX (ej. 1500 = 15.00%)
-        double usage_percentage = cpu_usage / 100.0;
-        double idle_percentage = 100.0 - usage_percentage;
+        // El JSON ya viene armado: solo se copia al cuerpo de la respuesta
+        crow::response res(200, snap->json);
+        res.set_header("Content-Type", "application/json");
+        return res;
+    });
 
-        // Construimos el JSON de respuesta
-        crow::json::wvalue response;
-        response["cpu_usage_percent"] = usage_percentage;
-        response["cpu_idle_percent"] = idle_percentage;
-        response["raw_value"] = cpu_usage;
+    // Endpoint: /stats/range?from=&to=&step= (segundos UNIX; responde desde memoria)
+    CROW_ROUTE(app, "/stats/range")([](const crow::request& req){
+        uint32_t now = (uint32_t)std::time(nullptr);
+        uint32_t to = std::min(url_param(req, "to", now), now);
+        uint32_t from = url_param(req, "from", to > 300 ? to - 300 : 0);
+        uint32_t step = std::max(url_param(req, "step", history.res), 1u);
 
-        return crow::response(response);
+        if (from > to)
+            return crow::response(400, "from debe ser menor o igual que to");
+
+        // Igual que /metrics: se arma directo en el cuerpo de la respuesta, sin copia final
+        thread_local size_t last_size = 0;
+        crow::response res(200);
+        res.body.reserve(last_size);
+        history.range(from, to, step, res.body);
+        last_size = res.body.size();
+
+        res.set_header("Content-Type", "application/json");
+        return res;
+    });
+
+    // Endpoint: /metrics (formato de texto de Prometheus)
+    CROW_ROUTE(app, "/metrics")([](){
+        thread_local std::vector<cpu_usage_stat> cpus;
+        thread_local size_t last_size = 0;
+
+        // El texto se arma directo en el cuerpo de la respuesta (sin copiarlo
+        // al final), reservando de una vez lo que ocupó el scrape anterior
+        crow::response res(200);
+        res.body.reserve(last_size);
+        render_metrics(res.body, cpus);
+        last_size = res.body.size();
+
+        res.set_header("Content-Type", "text/plain; version=0.0.4");
+        return res;
     });
 
+    // Endpoint: /stats/ws (WebSocket)
+    CROW_WEBSOCKET_ROUTE(app, "/stats/ws")
+        .onopen([](crow::websocket::connection& conn) {
+            std::lock_guard<std::mutex> lock(stream.mtx);
+            if (stream.subs.size() >= stream.max_clients) {
+                conn.close("Demasiados suscriptores");
+                return;
+            }
+            stream.subs.emplace(&conn, Subscriber{});
+        })
+        .onclose([](crow::websocket::connection& conn, const std::string&, uint16_t) {
+            std::lock_guard<std::mutex> lock(stream.mtx);
+            stream.subs.erase(&conn);
+        })
+        .onmessage([](crow::websocket::connection& conn, const std::string& data, bool) {
+            std::lock_guard<std::mutex> lock(stream.mtx);
+            auto it = stream.subs.find(&conn);
+            if (it == stream.subs.end())
+                return;
+            if (data == "ack") {
+                it->second.unacked = 0;
+            } else if (data.rfind("every ", 0) == 0) {
+                long every = std::strtol(data.c_str() + 6, nullptr, 10);
+                it->second.every = every > 0 ? every : 1;
+            }
+        });
+
+    // Hilo del muestreo: vive lo mismo que el servidor
+    std::thread(&StatsStream::run, &stream).detach();
+    std::thread(&StatsHistory::run, &history).detach();
+
     app.port(18080).multithreaded().run();
-}
\ No newline at end of file
+}
@@ -1,13 +1,35 @@
 #include <crow.h>
 #include <security/pam_appl.h>
 #include <security/pam_misc.h>
-#include <string>
+#include <sys/random.h>
+#include <string.h>    // explicit_bzero
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
 #include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "auth_json.h"
 
 /* ---------------- PAM ---------------- */
 
 static const char* PAM_SERVICE_NAME = "login";
 
+// Tamaños máximos de los campos de /auth (buffers fijos, sin memoria dinámica)
+static constexpr size_t USERNAME_MAX = 256;
+static constexpr size_t PASSWORD_MAX = 512;
+
 static int pam_conv_cb(int num_msg,
                        const struct pam_message **msg,
                        struct pam_response **resp,
@@ -24,6 +46,7 @@ static int pam_conv_cb(int num_msg,
     for (int i = 0; i < num_msg; i++) {
         switch (msg[i]->msg_style) {
             case PAM_PROMPT_ECHO_OFF:
+                // PAM libera 'resp' con free(): esta copia con malloc es obligatoria
                 responses[i].resp = strdup(password ? password : "");
                 responses[i].resp_retcode = 0;
                 break;
@@ -43,14 +66,15 @@ static int pam_conv_cb(int num_msg,
     return PAM_SUCCESS;
 }
 
-static bool pam_authenticate_user(const std::string& username,
-                                  const std::string& password,
-                                  std::string* error_out = nullptr)
+// error_out recibe el texto de pam_strerror (cadena estática de PAM, no hay que liberarla)
+static bool pam_authenticate_user(const char* username,
+                                  const char* password,
+                                  const char** error_out = nullptr)
 {
     pam_handle_t* pamh = nullptr;
-    struct pam_conv conv { pam_conv_cb, (void*)password.c_str() };
+    struct pam_conv conv { pam_conv_cb, (void*)password };
 
-    int r = pam_start(PAM_SERVICE_NAME, username.c_str(), &conv, &pamh);
+    int r = pam_start(PAM_SERVICE_NAME, username, &conv, &pamh);
     if (r != PAM_SUCCESS) {
         if (error_out) *error_out = pam_strerror(pamh, r);
         return false;
@@ -68,6 +92,514 @@ static bool pam_authenticate_user(const std::string& username,
     return ok;
 }
 
+/* ---------------- SESIONES ---------------- */
+
+/*
+ * Cada login exitoso con PAM devuelve un token "<id>.<secreto>" (hex).
+ * Las peticiones siguientes presentan el token (Authorization: Bearer ...)
+ * y se validan en memoria, sin volver a pasar por PAM.
+ *   - id (8 bytes al azar): elige el shard y la entrada; no es secreto.
+ *   - secreto (16 bytes al azar, de getrandom): se compara en tiempo constante.
+ * El almacén está dividido en shards con su propio mutex para que los hilos
+ * de Crow no compitan por un único lock. Memoria acotada (SESSION_MAX),
+ * expiración (SESSION_TTL_S) y revocación explícita (/auth/logout).
+ */
+
+// Lee un entero de una variable de entorno (o usa el valor por defecto)
+static long env_or(const char* name, long def)
+{
+    const char* v = std::getenv(name);
+    return v && *v ? std::strtol(v, nullptr, 10) : def;
+}
+
+using Clock = std::chrono::steady_clock;
+using Secret = std::array<uint8_t, 16>;
+
+// Compara sin salir antes: el tiempo no revela cuántos bytes coinciden
+static bool equal_const_time(const Secret& a, const Secret& b)
+{
+    volatile uint8_t diff = 0;
+    for (size_t i = 0; i < a.size(); i++)
+        diff |= a[i] ^ b[i];
+    return diff == 0;
+}
+
+static bool random_bytes(void* buf, size_t len)
+{
+    return getrandom(buf, len, 0) == (ssize_t)len;
+}
+
+static void to_hex(const uint8_t* in, size_t len, char* out)
+{
+    static const char digits[] = "0123456789abcdef";
+    for (size_t i = 0; i < len; i++) {
+        out[2 * i] = digits[in[i] >> 4];
+        out[2 * i + 1] = digits[in[i] & 0xf];
+    }
+}
+
+static bool from_hex(const char* in, size_t len, uint8_t* out)
+{
+    auto nibble = [](char c) -> int {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        return -1;
+    };
+    for (size_t i = 0; i < len; i++) {
+        int hi = nibble(in[2 * i]), lo = nibble(in[2 * i + 1]);
+        if (hi < 0 || lo < 0)
+            return false;
+        out[i] = (uint8_t)(hi << 4 | lo);
+    }
+    return true;
+}
+
+class SessionStore {
+public:
+    static constexpr size_t TOKEN_LEN = 16 + 1 + 32; // id.secreto en hex
+
+    SessionStore(std::chrono::seconds ttl, size_t max_sessions)
+        : ttl_(ttl), per_shard_(max_sessions / NR_SHARDS + 1) {}
+
+    std::chrono::seconds ttl() const { return ttl_; }
+
+    // Crea una sesión y escribe el token en 'token' (false si no hay aleatoriedad disponible)
+    bool create(const char* username, char (&token)[TOKEN_LEN])
+    {
+        uint64_t id;
+        Session s;
+        if (!random_bytes(&id, sizeof(id)) || !random_bytes(s.secret.data(), s.secret.size()))
+            return false;
+        std::snprintf(s.username, sizeof(s.username), "%s", username);
+        s.expires = Clock::now() + ttl_;
+
+        Shard& sh = shard(id);
+        {
+            std::lock_guard<std::mutex> lock(sh.mtx);
+            evict(sh, s.expires - ttl_);
+            compact(sh);
+            sh.sessions[id] = s;
+            sh.order.push_back({id, s.expires});
+        }
+
+        to_hex((const uint8_t*)&id, sizeof(id), token);
+        token[16] = '.';
+        to_hex(s.secret.data(), s.secret.size(), token + 17);
+        return true;
+    }
+
+    // Valida el token; si es válido copia el usuario en 'username' (USERNAME_MAX bytes)
+    bool verify(std::string_view token, char* username = nullptr)
+    {
+        uint64_t id;
+        Secret secret;
+        if (!parse(token, id, secret))
+            return false;
+
+        Shard& sh = shard(id);
+        std::lock_guard<std::mutex> lock(sh.mtx);
+        auto it = sh.sessions.find(id);
+        if (it == sh.sessions.end() || it->second.expires <= Clock::now())
+            return false;
+        if (!equal_const_time(it->second.secret, secret))
+            return false;
+        if (username)
+            std::memcpy(username, it->second.username, USERNAME_MAX);
+        return true;
+    }
+
+    // Revoca la sesión (solo si el token completo es válido)
+    bool revoke(std::string_view token)
+    {
+        uint64_t id;
+        Secret secret;
+        if (!parse(token, id, secret))
+            return false;
+
+        Shard& sh = shard(id);
+        std::lock_guard<std::mutex> lock(sh.mtx);
+        auto it = sh.sessions.find(id);
+        if (it == sh.sessions.end() || !equal_const_time(it->second.secret, secret))
+            return false;
+        sh.sessions.erase(it); // Su entrada en 'order' la quita evict o compact
+        return true;
+    }
+
+private:
+    static constexpr size_t NR_SHARDS = 16;
+
+    struct Session {
+        Secret secret;
+        char username[USERNAME_MAX];
+        Clock::time_point expires;
+    };
+
+    struct Shard {
+        std::mutex mtx;
+        std::unordered_map<uint64_t, Session> sessions;
+        // Orden de creación = orden de expiración (el TTL es el mismo para todas)
+        std::deque<std::pair<uint64_t, Clock::time_point>> order;
+    };
+
+    Shard& shard(uint64_t id) { return shards_[id % NR_SHARDS]; }
+
+    static bool parse(std::string_view token, uint64_t& id, Secret& secret)
+    {
+        if (token.size() != TOKEN_LEN || token[16] != '.')
+            return false;
+        return from_hex(token.data(), sizeof(id), (uint8_t*)&id) &&
+               from_hex(token.data() + 17, secret.size(), secret.data());
+    }
+
+    // Con el lock del shard: saca las vencidas y, si sigue lleno, las más viejas
+    void evict(Shard& sh, Clock::time_point now)
+    {
+        while (!sh.order.empty()) {
+            auto [id, expires] = sh.order.front();
+            auto it = sh.sessions.find(id);
+            bool stale = it == sh.sessions.end() || it->second.expires != expires; // Ya revocada
+            if (!stale && expires > now && sh.sessions.size() < per_shard_)
+                break;
+            if (!stale)
+                sh.sessions.erase(it);
+            sh.order.pop_front();
+        }
+    }
+
+    // Con el lock del shard: las revocadas en medio de 'order' solo salen por el
+    // frente al vencer. Cuando ya son la mitad de la cola, se quitan todas de
+    // una vez (remove_if conserva el orden): así 'order' nunca pasa de ~2x las
+    // sesiones vivas y el costo por inserción sigue siendo O(1) amortizado.
+    static void compact(Shard& sh)
+    {
+        if (sh.order.size() < 64 || sh.order.size() < 2 * sh.sessions.size())
+            return;
+        sh.order.erase(std::remove_if(sh.order.begin(), sh.order.end(),
+                                      [&sh](const std::pair<uint64_t, Clock::time_point>& e) {
+                                          auto it = sh.sessions.find(e.first);
+                                          return it == sh.sessions.end() || it->second.expires != e.second;
+                                      }),
+                       sh.order.end());
+    }
+
+    std::chrono::seconds ttl_;
+    size_t per_shard_;
+    Shard shards_[NR_SHARDS];
+};
+
+// Saca el token de "Authorization: Bearer <token>" (vista sobre el header, sin copiar)
+static std::string_view bearer_token(const crow::request& req)
+{
+    std::string_view h = req.get_header_value("Authorization");
+    return h.substr(0, 7) == "Bearer " ? h.substr(7) : std::string_view();
+}
+
+/* ---------------- POOL DE PAM ---------------- */
+
+/*
+ * PAM puede tardar (fail-delay, backends remotos) y cada login abría su propia
+ * llamada: una ráfaga de logins lentos se comía todos los hilos de Crow y rutas
+ * baratas como "/" quedaban esperando detrás. Ahora /auth encola el trabajo en
+ * un pool propio y solo PAM corre ahí; el hilo de Crow espera el resultado y
+ * termina la respuesta él mismo (crow::response no se toca desde otro hilo):
+ *   PAM_WORKERS      hilos que llaman a PAM (por defecto 4)
+ *   PAM_QUEUE        máximo de logins esperando (por defecto 64); lleno -> 503
+ *   PAM_DEADLINE_MS  tiempo máximo en la cola (por defecto 5000); vencido -> 503
+ * Una llamada a PAM ya iniciada no se puede cortar: el plazo se revisa
+ * al sacar el trabajo de la cola, antes de tocar PAM.
+ */
+enum class PamOutcome { Ok, Denied, Expired };
+
+// Dónde espera el hilo de Crow a su login. Vive en la pila del handler.
+class PamWait {
+public:
+    // Lo llama el hilo del pool. Se avisa con el lock tomado: en cuanto se
+    // suelta, el handler puede volver y destruir este objeto.
+    void finish(PamOutcome outcome, const char* error)
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        outcome_ = outcome;
+        error_ = error;
+        finished_ = true;
+        cv_.notify_one();
+    }
+
+    PamOutcome wait(const char** error)
+    {
+        std::unique_lock<std::mutex> lock(mtx_);
+        cv_.wait(lock, [this] { return finished_; });
+        *error = error_;
+        return outcome_;
+    }
+
+private:
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    bool finished_ = false;
+    PamOutcome outcome_ = PamOutcome::Expired;
+    const char* error_ = "";
+};
+
+/*
+ * Un login pendiente. Todo va en buffers fijos dentro del trabajo: encolarlo
+ * es copiar bytes a un slot ya reservado del anillo, sin std::string ni
+ * std::function (y la contraseña no queda regada en el heap).
+ */
+struct PamJob {
+    char username[USERNAME_MAX];
+    char password[PASSWORD_MAX];
+    PamWait* wait; // A quién avisar; la respuesta HTTP nunca pasa por el pool
+    Clock::time_point enqueued;
+    Clock::time_point deadline;
+};
+
+class PamPool {
+public:
+    PamPool(size_t workers, size_t capacity, std::chrono::milliseconds deadline)
+        : deadline_(deadline), ring_(capacity)
+    {
+        for (size_t i = 0; i < workers; i++)
+            std::thread(&PamPool::run, this).detach();
+    }
+
+    // Copia el trabajo a la cola; false si está llena (la petición se rechaza sin esperar)
+    bool submit(const PamJob& job)
+    {
+        std::unique_lock<std::mutex> lock(mtx_);
+        if (count_ >= ring_.size()) {
+            rejected_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        PamJob& slot = ring_[(head_ + count_) % ring_.size()];
+        slot = job;
+        slot.enqueued = Clock::now();
+        slot.deadline = slot.enqueued + deadline_;
+        count_++;
+        depth_.store(count_, std::memory_order_relaxed);
+        lock.unlock();
+        cv_.notify_one();
+        return true;
+    }
+
+    // Métricas en formato de texto de Prometheus
+    void render_metrics(std::string& out) const
+    {
+        char buf[1024];
+        std::snprintf(buf, sizeof(buf),
+            "# HELP pam_queue_depth Logins esperando un hilo de PAM.\n"
+            "# TYPE pam_queue_depth gauge\n"
+            "pam_queue_depth %zu\n"
+            "# HELP pam_queue_wait_seconds Tiempo total que esperaron en la cola los logins atendidos.\n"
+            "# TYPE pam_queue_wait_seconds summary\n"
+            "pam_queue_wait_seconds_sum %.6f\n"
+            "pam_queue_wait_seconds_count %llu\n"
+            "# HELP pam_rejected_total Logins rechazados con la cola llena.\n"
+            "# TYPE pam_rejected_total counter\n"
+            "pam_rejected_total %llu\n"
+            "# HELP pam_expired_total Logins que vencieron en la cola.\n"
+            "# TYPE pam_expired_total counter\n"
+            "pam_expired_total %llu\n",
+            depth_.load(std::memory_order_relaxed),
+            wait_ns_.load(std::memory_order_relaxed) / 1e9,
+            (unsigned long long)served_.load(std::memory_order_relaxed),
+            (unsigned long long)rejected_.load(std::memory_order_relaxed),
+            (unsigned long long)expired_.load(std::memory_order_relaxed));
+        out += buf;
+    }
+
+private:
+    void run()
+    {
+        PamJob job; // Copia local: el slot del anillo se libera enseguida
+        for (;;) {
+            std::unique_lock<std::mutex> lock(mtx_);
+            cv_.wait(lock, [this] { return count_ > 0; });
+            PamJob& slot = ring_[head_];
+            job = slot;
+            explicit_bzero(slot.password, sizeof(slot.password));
+            head_ = (head_ + 1) % ring_.size();
+            count_--;
+            depth_.store(count_, std::memory_order_relaxed);
+            lock.unlock();
+
+            auto now = Clock::now();
+            if (now > job.deadline) {
+                expired_.fetch_add(1, std::memory_order_relaxed);
+                explicit_bzero(job.password, sizeof(job.password));
+                job.wait->finish(PamOutcome::Expired, "");
+                continue;
+            }
+            wait_ns_.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(now - job.enqueued).count(),
+                               std::memory_order_relaxed);
+            served_.fetch_add(1, std::memory_order_relaxed);
+
+            const char* pam_err = "";
+            bool ok = pam_authenticate_user(job.username, job.password, &pam_err);
+            explicit_bzero(job.password, sizeof(job.password));
+            job.wait->finish(ok ? PamOutcome::Ok : PamOutcome::Denied, pam_err);
+        }
+    }
+
+    std::chrono::milliseconds deadline_;
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    std::vector<PamJob> ring_; // Anillo de PAM_QUEUE slots reservado al arrancar
+    size_t head_ = 0, count_ = 0;
+
+    std::atomic<size_t> depth_{0};
+    std::atomic<uint64_t> wait_ns_{0}, served_{0}, rejected_{0}, expired_{0};
+};
+
+/*
+ * Respuestas JSON: los pedazos fijos ya están serializados y solo se escapan
+ * los valores variables, escribiendo en un buffer del hilo (auth_json::Writer).
+ * La única copia que queda es la que hace Crow al guardar el cuerpo en res.body.
+ */
+static void set_json(crow::response& res, int code, std::string_view body)
+{
+    res.code = code;
+    res.set_header("Content-Type", "application/json");
+    res.body.assign(body.data(), body.size());
+}
+
+// Termina la respuesta con un cuerpo JSON
+static void finish_json(crow::response& res, int code, std::string_view body)
+{
+    set_json(res, code, body);
+    res.end();
+}
+
+// 503 rápido: el cliente puede reintentar en PAM_RETRY_AFTER_S segundos
+static void finish_busy(crow::response& res)
+{
+    static const std::string retry_after = std::to_string(env_or("PAM_RETRY_AFTER_S", 1));
+    res.code = 503;
+    res.set_header("Retry-After", retry_after);
+    res.body = "Servicio de autenticación ocupado, reintente";
+    res.end();
+}
+
+/* ---------------- LÍMITE DE INTENTOS ---------------- */
+
+/*
+ * Antes cada intento fallido llegaba hasta PAM: una ráfaga de credential
+ * stuffing costaba tanta CPU como los logins reales. Ahora cada IP y cada
+ * usuario tienen un "balde de fichas" y lo que se pasa del presupuesto se
+ * rechaza con 429 ANTES de tocar PAM.
+ *
+ * Implementación (GCRA, equivalente a un token bucket):
+ *   - Por cada clave se guarda un solo número: el "tiempo teórico" (tat) en µs.
+ *     Cada intento lo adelanta un intervalo (60 s / por_minuto). Si tat se
+ *     adelanta al reloj más que (ráfaga - 1) intervalos, la clave se pasó.
+ *     Con el tiempo el reloj alcanza a tat: esa es la recarga (decay).
+ *   - Tabla de tamaño fijo, sin locks: cada slot es {hash de la clave, tat}
+ *     y se actualiza con compare_exchange. El hash elige un shard de 8
+ *     slots seguidos y solo se busca dentro de él.
+ *   - Un slot cuyo tat ya quedó en el pasado equivale a un balde lleno:
+ *     se puede reutilizar para otra clave. Si el shard está lleno de claves
+ *     activas, la nueva comparte el slot de su hash (se limita de más, nunca de menos).
+ */
+class RateLimiter {
+public:
+    // per_minute = 0 desactiva el límite
+    RateLimiter(long per_minute, long burst, size_t slots)
+        : interval_us_(per_minute > 0 ? 60000000 / per_minute : 0),
+          tolerance_us_(interval_us_ * (std::max(1L, burst) - 1)),
+          nr_shards_(std::max<size_t>(1, slots / SHARD_SLOTS)),
+          table_(nr_shards_ * SHARD_SLOTS) {}
+
+    // Cobra un intento. Si no hay fichas devuelve false y los segundos a esperar.
+    bool take(std::string_view key, unsigned* retry_after_s)
+    {
+        if (!interval_us_)
+            return true;
+        uint64_t now = now_us();
+        Slot& slot = find(key, now);
+        uint64_t tat = slot.tat.load(std::memory_order_relaxed);
+        for (;;) {
+            uint64_t base = std::max(tat, now);
+            if (base - now > tolerance_us_) {
+                *retry_after_s = (unsigned)((base - now - tolerance_us_) / 1000000 + 1);
+                return false;
+            }
+            if (slot.tat.compare_exchange_weak(tat, base + interval_us_, std::memory_order_relaxed))
+                return true;
+        }
+    }
+
+    // Devuelve la ficha de un intento que terminó bien (solo los fallos gastan presupuesto)
+    void refund(std::string_view key)
+    {
+        if (!interval_us_)
+            return;
+        uint64_t now = now_us();
+        Slot& slot = find(key, now);
+        uint64_t tat = slot.tat.load(std::memory_order_relaxed);
+        while (tat > now && !slot.tat.compare_exchange_weak(tat, std::max(tat - interval_us_, now),
+                                                            std::memory_order_relaxed)) {
+        }
+    }
+
+private:
+    static constexpr size_t SHARD_SLOTS = 8;
+
+    struct Slot {
+        std::atomic<uint64_t> key{0}; // Hash de la clave (0 = libre)
+        std::atomic<uint64_t> tat{0}; // Tiempo teórico en µs desde que arrancó el proceso
+    };
+
+    static uint64_t now_us()
+    {
+        static const Clock::time_point start = Clock::now();
+        return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count() + 1;
+    }
+
+    // FNV-1a de 64 bits (0 queda reservado para "slot libre")
+    static uint64_t hash(std::string_view key)
+    {
+        uint64_t h = 1469598103934665603ULL;
+        for (unsigned char c : key)
+            h = (h ^ c) * 1099511628211ULL;
+        return h ? h : 1;
+    }
+
+    Slot& find(std::string_view key, uint64_t now)
+    {
+        uint64_t h = hash(key);
+        Slot* shard = &table_[(h % nr_shards_) * SHARD_SLOTS];
+
+        // 1. ¿La clave ya tiene slot?
+        for (size_t i = 0; i < SHARD_SLOTS; i++) {
+            if (shard[i].key.load(std::memory_order_relaxed) == h)
+                return shard[i];
+        }
+        // 2. Tomar un slot libre o uno cuyo balde ya se llenó (tat en el pasado)
+        for (size_t i = 0; i < SHARD_SLOTS; i++) {
+            uint64_t old = shard[i].key.load(std::memory_order_relaxed);
+            if (old != 0 && shard[i].tat.load(std::memory_order_relaxed) > now)
+                continue; // Otra clave con intentos recientes
+            if (shard[i].key.compare_exchange_strong(old, h, std::memory_order_relaxed) || old == h)
+                return shard[i];
+        }
+        // 3. Shard lleno de claves activas: compartir el slot que le toca por hash
+        return shard[h / nr_shards_ % SHARD_SLOTS];
+    }
+
+    uint64_t interval_us_;
+    uint64_t tolerance_us_;
+    size_t nr_shards_;
+    std::vector<Slot> table_;
+};
+
+// 429 con el tiempo a esperar
+static void finish_limited(crow::response& res, unsigned retry_after_s)
+{
+    res.code = 429;
+    res.set_header("Retry-After", std::to_string(retry_after_s));
+    res.body = "Demasiados intentos, reintente más tarde";
+    res.end();
+}
+
 /* ---------------- CORS ---------------- */
 
 struct CORS {
@@ -79,8 +611,8 @@ struct CORS {
     {
         if (req.method == crow::HTTPMethod::OPTIONS) {
             res.add_header("Access-Control-Allow-Origin", "*");
-            res.add_header("Access-Control-Allow-Headers", "Content-Type");
-            res.add_header("Access-Control-Allow-Methods", "POST,OPTIONS");
+            res.add_header("Access-Control-Allow-Headers", "Content-Type, Authorization");
+            res.add_header("Access-Control-Allow-Methods", "GET,POST,OPTIONS");
             res.code = 204;
             res.end();
         }
@@ -91,8 +623,8 @@ struct CORS {
                       context&)
     {
         res.add_header("Access-Control-Allow-Origin", "*");
-        res.add_header("Access-Control-Allow-Headers", "Content-Type");
-        res.add_header("Access-Control-Allow-Methods", "POST,OPTIONS");
+        res.add_header("Access-Control-Allow-Headers", "Content-Type, Authorization");
+        res.add_header("Access-Control-Allow-Methods", "GET,POST,OPTIONS");
     }
 };
 
@@ -101,34 +633,133 @@ struct CORS {
 int main()
 {
     crow::App<CORS> app;
+    // SESSION_TTL_S: vida de un token (por defecto 15 min); SESSION_MAX: sesiones simultáneas
+    static SessionStore sessions(std::chrono::seconds(env_or("SESSION_TTL_S", 900)),
+                                 env_or("SESSION_MAX", 10000));
+    // Límites por IP y por usuario (intentos por minuto y ráfaga); RATE_SLOTS: claves en memoria
+    static RateLimiter ip_limiter(env_or("RATE_IP_PER_MIN", 60), env_or("RATE_IP_BURST", 20),
+                                  env_or("RATE_SLOTS", 65536));
+    static RateLimiter user_limiter(env_or("RATE_USER_PER_MIN", 10), env_or("RATE_USER_BURST", 5),
+                                    env_or("RATE_SLOTS", 65536));
+    // Nunca se destruye: sus hilos siguen esperando en la cola hasta que termina el proceso
+    static PamPool& pam_pool = *new PamPool(std::max(1L, env_or("PAM_WORKERS", 4)),
+                                            std::max(1L, env_or("PAM_QUEUE", 64)),
+                                            std::chrono::milliseconds(env_or("PAM_DEADLINE_MS", 5000)));
 
     CROW_ROUTE(app, "/")([]{
         return "Hello world from C++;";
     });
 
+    // PAM corre en el pool; el hilo de Crow espera el resultado y termina 'res'
     CROW_ROUTE(app, "/auth").methods(crow::HTTPMethod::POST)
-    ([](const crow::request& req){
-        auto json = crow::json::load(req.body);
-        if (!json || !json.has("username") || !json.has("password")) {
-            return crow::response(400,
-                "JSON con 'username' y 'password' requerido");
+    ([](const crow::request& req, crow::response& res){
+        // 1. LÍMITE POR IP: antes incluso de parsear el cuerpo
+        unsigned retry_after;
+        if (!ip_limiter.take(req.remote_ip_address, &retry_after)) {
+            finish_limited(res, retry_after);
+            return;
+        }
+
+        // 2. PARSEO: usuario y contraseña directo a los buffers del trabajo
+        PamJob job;
+        if (!auth_json::parse_credentials(req.body, job.username, sizeof(job.username),
+                                          job.password, sizeof(job.password))) {
+            explicit_bzero(job.password, sizeof(job.password));
+            res.code = 400;
+            res.body = "JSON con 'username' y 'password' requerido";
+            res.end();
+            return;
+        }
+
+        // 3. LÍMITE POR USUARIO: todavía sin tocar PAM
+        if (!user_limiter.take(job.username, &retry_after)) {
+            explicit_bzero(job.password, sizeof(job.password));
+            finish_limited(res, retry_after);
+            return;
+        }
+
+        // 4. ENCOLAR: el trabajo se copia al anillo y la copia local se borra
+        PamWait wait;
+        job.wait = &wait;
+        bool queued = pam_pool.submit(job);
+        explicit_bzero(job.password, sizeof(job.password));
+        if (!queued) {
+            ip_limiter.refund(req.remote_ip_address);
+            user_limiter.refund(job.username);
+            finish_busy(res);
+            return;
+        }
+
+        // 5. ESPERAR a PAM y responder desde este mismo hilo
+        const char* pam_err;
+        PamOutcome outcome = wait.wait(&pam_err);
+        thread_local char out[USERNAME_MAX * 6 + 128]; // Peor caso: cada byte escapado como \u00XX
+        auth_json::Writer w(out, sizeof(out));
+
+        if (outcome == PamOutcome::Expired) {
+            // No llegó a PAM: el intento no se cobra
+            ip_limiter.refund(req.remote_ip_address);
+            user_limiter.refund(job.username);
+            finish_busy(res);
+            return;
+        }
+        if (outcome == PamOutcome::Denied) {
+            w.raw(R"({"ok":false,"error":")").escaped(pam_err).raw(R"("})");
+            finish_json(res, 401, w.view());
+            return;
         }
 
-        std::string username = json["username"].s();
-        std::string password = json["password"].s();
+        // Login correcto: no cuenta como intento fallido
+        ip_limiter.refund(req.remote_ip_address);
+        user_limiter.refund(job.username);
 
-        std::string pam_err;
-        if (!pam_authenticate_user(username, password, &pam_err)) {
-            crow::json::wvalue body;
-            body["ok"] = false;
-            body["error"] = pam_err;
-            return crow::response(401, body);
+        char token[SessionStore::TOKEN_LEN];
+        if (!sessions.create(job.username, token)) {
+            res.code = 500;
+            res.body = "No se pudo crear la sesión";
+            res.end();
+            return;
         }
 
-        crow::json::wvalue body;
-        body["ok"] = true;
-        body["username"] = username;
-        return crow::response(200, body);
+        w.raw(R"({"ok":true,"username":")").escaped(job.username)
+         .raw(R"(","token":")").raw(std::string_view(token, sizeof(token)))
+         .raw(R"(","expires_in":)").number(sessions.ttl().count())
+         .raw("}");
+        finish_json(res, 200, w.view());
+    });
+
+    // Valida un token sin pasar por PAM
+    CROW_ROUTE(app, "/auth/session").methods(crow::HTTPMethod::GET)
+    ([](const crow::request& req){
+        static constexpr std::string_view INVALID = R"({"ok":false,"error":"Sesión inválida o vencida"})";
+        thread_local char out[USERNAME_MAX * 6 + 32]; // Peor caso: cada byte escapado como \u00XX
+        char username[USERNAME_MAX];
+        crow::response res;
+
+        if (!sessions.verify(bearer_token(req), username)) {
+            set_json(res, 401, INVALID);
+            return res;
+        }
+
+        auth_json::Writer w(out, sizeof(out));
+        w.raw(R"({"ok":true,"username":")").escaped(username).raw(R"("})");
+        set_json(res, 200, w.view());
+        return res;
+    });
+
+    // Revoca el token (cerrar sesión)
+    CROW_ROUTE(app, "/auth/logout").methods(crow::HTTPMethod::POST)
+    ([](const crow::request& req){
+        return crow::response(sessions.revoke(bearer_token(req)) ? 204 : 401);
+    });
+
+    // Métricas del pool de PAM (formato de texto de Prometheus)
+    CROW_ROUTE(app, "/metrics")([](){
+        std::string body;
+        pam_pool.render_metrics(body);
+        crow::response res(200, body);
+        res.set_header("Content-Type", "text/plain; version=0.0.4");
+        return res;
     });
 
     app.port(18080).multithreaded().run();
@@ -0,0 +1,92 @@
+/*
+ * auth_bench.cpp
+ * Compara el camino viejo de /auth (crow::json::load + std::string + wvalue::dump)
+ * con el nuevo (auth_json::parse_credentials + auth_json::Writer):
+ * tiempo por petición y reservas de memoria por petición.
+ *
+ * Las reservas se cuentan reemplazando el operator new global.
+ */
+#include "crow.h"
+#include "auth_json.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+
+static std::atomic<unsigned long> allocations{0};
+
+void* operator new(size_t n)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(n ? n : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+static const std::string BODY = R"({"username": "estudiante", "password": "s3cr3t\"oñ"})";
+static const char TOKEN[] = "0123456789abcdef.0123456789abcdef0123456789abcdef";
+
+// Lo que hacía /auth antes: árbol JSON, copias a std::string y wvalue para la respuesta
+static size_t old_path()
+{
+    auto json = crow::json::load(BODY);
+    if (!json || !json.has("username") || !json.has("password"))
+        return 0;
+    std::string username = json["username"].s();
+    std::string password = json["password"].s();
+
+    crow::json::wvalue body;
+    body["ok"] = true;
+    body["username"] = username;
+    body["token"] = std::string(TOKEN);
+    body["expires_in"] = 900;
+    return body.dump().size() + password.size();
+}
+
+// Lo que hace ahora: buffers fijos para leer y para escribir
+static size_t new_path()
+{
+    char username[256], password[512], out[2048];
+    if (!auth_json::parse_credentials(BODY, username, sizeof(username), password, sizeof(password)))
+        return 0;
+
+    auth_json::Writer w(out, sizeof(out));
+    w.raw(R"({"ok":true,"username":")").escaped(username)
+     .raw(R"(","token":")").raw(TOKEN)
+     .raw(R"(","expires_in":)").number(900)
+     .raw("}");
+    return w.view().size() + password[0];
+}
+
+static void run(const char* name, size_t (*fn)(), int iterations)
+{
+    volatile size_t sink = 0;
+    unsigned long before = allocations.load();
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++)
+        sink = sink + fn();
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    unsigned long allocs = allocations.load() - before;
+
+    std::printf("%-6s %8.1f ns/petición  %6.2f reservas/petición\n",
+                name, (double)ns / iterations, (double)allocs / iterations);
+}
+
+int main(int argc, char** argv)
+{
+    int iterations = argc > 1 ? std::atoi(argv[1]) : 1000000;
+    if (iterations <= 0)
+        iterations = 1;
+
+    run("viejo", old_path, iterations);
+    run("nuevo", new_path, iterations);
+    return 0;
+}
+
+/* g++ -O2 auth_bench.cpp -o auth_bench -lpthread */
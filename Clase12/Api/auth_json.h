@@ -0,0 +1,327 @@
+/*
+ * auth_json.h
+ * Parser y escritor de JSON mínimos para /auth, sin memoria dinámica.
+ *
+ * El cuerpo de /auth siempre es {"username": "...", "password": "..."}.
+ * En vez de armar un árbol (crow::json::load) y copiar a std::string, se
+ * recorre el texto UNA vez sobre un std::string_view y los dos valores se
+ * decodifican directo en buffers del que llama. Las claves desconocidas se
+ * saltan sin copiar nada.
+ */
+#ifndef AUTH_JSON_H
+#define AUTH_JSON_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace auth_json {
+
+class Reader {
+public:
+    explicit Reader(std::string_view text) : p_(text.data()), end_(text.data() + text.size()) {}
+
+    void skip_ws()
+    {
+        while (p_ < end_ && (*p_ == ' ' || *p_ == '\t' || *p_ == '\n' || *p_ == '\r'))
+            p_++;
+    }
+
+    bool eat(char c)
+    {
+        skip_ws();
+        if (p_ < end_ && *p_ == c) {
+            p_++;
+            return true;
+        }
+        return false;
+    }
+
+    bool at_end()
+    {
+        skip_ws();
+        return p_ == end_;
+    }
+
+    /*
+     * Lee un string JSON y lo decodifica en out[0..cap) terminado en '\0'.
+     * Falla si no cabe o si contiene un '\0' (PAM trabaja con cadenas de C).
+     * Con out == nullptr solo lo salta.
+     */
+    bool string(char* out, size_t cap, size_t* len_out = nullptr)
+    {
+        size_t len = 0;
+        if (!eat('"'))
+            return false;
+        while (p_ < end_ && *p_ != '"') {
+            uint32_t cp = (unsigned char)*p_++;
+            if (cp < 0x20)
+                return false; // Caracter de control sin escapar
+            if (cp == '\\') {
+                if (p_ >= end_)
+                    return false;
+                char e = *p_++;
+                switch (e) {
+                    case '"': cp = '"'; break;
+                    case '\\': cp = '\\'; break;
+                    case '/': cp = '/'; break;
+                    case 'b': cp = '\b'; break;
+                    case 'f': cp = '\f'; break;
+                    case 'n': cp = '\n'; break;
+                    case 'r': cp = '\r'; break;
+                    case 't': cp = '\t'; break;
+                    case 'u':
+                        if (!unicode(cp))
+                            return false;
+                        break;
+                    default:
+                        return false;
+                }
+                if (cp == 0)
+                    return false;
+                if (!put_utf8(cp, out, cap, len))
+                    return false;
+                continue;
+            }
+            // Byte normal (incluye los bytes de UTF-8 ya codificado): se copia tal cual
+            if (out) {
+                if (len + 1 >= cap)
+                    return false;
+                out[len] = (char)cp;
+            }
+            len++;
+        }
+        if (p_ >= end_)
+            return false;
+        p_++; // Comilla de cierre
+        if (out)
+            out[len] = '\0';
+        if (len_out)
+            *len_out = len;
+        return true;
+    }
+
+    // Salta cualquier valor JSON (para las claves que no nos interesan)
+    bool skip_value(int depth = 0)
+    {
+        if (depth > 32)
+            return false;
+        skip_ws();
+        if (p_ >= end_)
+            return false;
+        char c = *p_;
+        if (c == '"')
+            return string(nullptr, 0);
+        if (c == '{' || c == '[') {
+            char close = c == '{' ? '}' : ']';
+            p_++;
+            if (eat(close))
+                return true;
+            do {
+                if (c == '{' && (!string(nullptr, 0) || !eat(':')))
+                    return false;
+                if (!skip_value(depth + 1))
+                    return false;
+            } while (eat(','));
+            return eat(close);
+        }
+        // Número, true, false o null: hasta el siguiente separador
+        const char* start = p_;
+        while (p_ < end_ && *p_ != ',' && *p_ != '}' && *p_ != ']' && *p_ != ' ' &&
+               *p_ != '\t' && *p_ != '\n' && *p_ != '\r')
+            p_++;
+        return p_ > start;
+    }
+
+private:
+    bool hex4(uint32_t& v)
+    {
+        if (end_ - p_ < 4)
+            return false;
+        v = 0;
+        for (int i = 0; i < 4; i++) {
+            char c = *p_++;
+            v <<= 4;
+            if (c >= '0' && c <= '9') v |= c - '0';
+            else if (c >= 'a' && c <= 'f') v |= c - 'a' + 10;
+            else if (c >= 'A' && c <= 'F') v |= c - 'A' + 10;
+            else return false;
+        }
+        return true;
+    }
+
+    // \uXXXX, incluyendo pares sustitutos (😀)
+    bool unicode(uint32_t& cp)
+    {
+        if (!hex4(cp))
+            return false;
+        if (cp >= 0xDC00 && cp <= 0xDFFF)
+            return false;
+        if (cp >= 0xD800 && cp <= 0xDBFF) {
+            uint32_t lo;
+            if (end_ - p_ < 6 || p_[0] != '\\' || p_[1] != 'u')
+                return false;
+            p_ += 2;
+            if (!hex4(lo) || lo < 0xDC00 || lo > 0xDFFF)
+                return false;
+            cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+        }
+        return true;
+    }
+
+    static bool put_utf8(uint32_t cp, char* out, size_t cap, size_t& len)
+    {
+        char tmp[4];
+        size_t n;
+        if (cp < 0x80) {
+            tmp[0] = (char)cp;
+            n = 1;
+        } else if (cp < 0x800) {
+            tmp[0] = (char)(0xC0 | cp >> 6);
+            tmp[1] = (char)(0x80 | (cp & 0x3F));
+            n = 2;
+        } else if (cp < 0x10000) {
+            tmp[0] = (char)(0xE0 | cp >> 12);
+            tmp[1] = (char)(0x80 | (cp >> 6 & 0x3F));
+            tmp[2] = (char)(0x80 | (cp & 0x3F));
+            n = 3;
+        } else {
+            tmp[0] = (char)(0xF0 | cp >> 18);
+            tmp[1] = (char)(0x80 | (cp >> 12 & 0x3F));
+            tmp[2] = (char)(0x80 | (cp >> 6 & 0x3F));
+            tmp[3] = (char)(0x80 | (cp & 0x3F));
+            n = 4;
+        }
+        if (out) {
+            if (len + n >= cap)
+                return false;
+            for (size_t i = 0; i < n; i++)
+                out[len + i] = tmp[i];
+        }
+        len += n;
+        return true;
+    }
+
+    const char* p_;
+    const char* end_;
+};
+
+/*
+ * Lee {"username": "...", "password": "..."} (en cualquier orden, con otras
+ * claves que se ignoran). Devuelve false si falta alguno, si no es string
+ * o si no cabe en su buffer.
+ */
+inline bool parse_credentials(std::string_view body,
+                              char* username, size_t username_cap,
+                              char* password, size_t password_cap)
+{
+    Reader r(body);
+    bool have_user = false, have_pass = false;
+    char key[16];
+
+    if (!r.eat('{'))
+        return false;
+    if (!r.eat('}')) {
+        do {
+            size_t key_len;
+            // Claves largas no son las nuestras: se saltan
+            Reader probe = r;
+            if (!probe.string(key, sizeof(key), &key_len)) {
+                if (!r.string(nullptr, 0))
+                    return false;
+                key[0] = '\0';
+            } else {
+                r = probe;
+            }
+            if (!r.eat(':'))
+                return false;
+
+            std::string_view k(key);
+            if (k == "username") {
+                if (!r.string(username, username_cap))
+                    return false;
+                have_user = true;
+            } else if (k == "password") {
+                if (!r.string(password, password_cap))
+                    return false;
+                have_pass = true;
+            } else if (!r.skip_value()) {
+                return false;
+            }
+        } while (r.eat(','));
+        if (!r.eat('}'))
+            return false;
+    }
+    return r.at_end() && have_user && have_pass;
+}
+
+/*
+ * Escritor sobre un buffer fijo: las respuestas se arman con pedazos
+ * pre-serializados y solo se escapan los valores variables.
+ */
+class Writer {
+public:
+    Writer(char* buf, size_t cap) : buf_(buf), cap_(cap) {}
+
+    Writer& raw(std::string_view s)
+    {
+        for (char c : s)
+            put(c);
+        return *this;
+    }
+
+    // Valor de un string JSON (sin las comillas), escapando lo necesario
+    Writer& escaped(std::string_view s)
+    {
+        static const char hex[] = "0123456789abcdef";
+        for (char c : s) {
+            unsigned char u = (unsigned char)c;
+            if (c == '"' || c == '\\') {
+                put('\\');
+                put(c);
+            } else if (u < 0x20) {
+                raw("\\u00");
+                put(hex[u >> 4]);
+                put(hex[u & 0xF]);
+            } else {
+                put(c);
+            }
+        }
+        return *this;
+    }
+
+    Writer& number(long v)
+    {
+        char tmp[24];
+        size_t n = 0;
+        unsigned long u = v < 0 ? 0UL - (unsigned long)v : (unsigned long)v;
+        do {
+            tmp[n++] = (char)('0' + u % 10);
+            u /= 10;
+        } while (u);
+        if (v < 0)
+            put('-');
+        while (n)
+            put(tmp[--n]);
+        return *this;
+    }
+
+    bool ok() const { return len_ <= cap_; }
+    std::string_view view() const { return std::string_view(buf_, len_ <= cap_ ? len_ : cap_); }
+
+private:
+    void put(char c)
+    {
+        if (len_ < cap_)
+            buf_[len_] = c;
+        len_++;
+    }
+
+    char* buf_;
+    size_t cap_;
+    size_t len_ = 0;
+};
+
+} // namespace auth_json
+
+#endif /* AUTH_JSON_H */
@@ -1,4 +1,4 @@
-import { HttpClient } from '@angular/common/http';
+import { HttpClient, HttpHeaders } from '@angular/common/http';
 import { inject, Injectable } from '@angular/core';
 import { lastValueFrom } from 'rxjs';
 
@@ -12,6 +12,19 @@ export class Auth {
   async authLogin(login: AuthLogin){
     return lastValueFrom(this.http.post<ResponseLogin>(this.base + "/auth", login));
   }
+
+  // Valida el token guardado sin volver a pedir la contraseña (no pasa por PAM)
+  async authSession(token: string){
+    return lastValueFrom(this.http.get<ResponseLogin>(this.base + "/auth/session", { headers: this.bearer(token) }));
+  }
+
+  async authLogout(token: string){
+    return lastValueFrom(this.http.post(this.base + "/auth/logout", null, { headers: this.bearer(token) }));
+  }
+
+  private bearer(token: string){
+    return new HttpHeaders({ Authorization: `Bearer ${token}` });
+  }
   
 }
 
@@ -24,4 +37,6 @@ export interface ResponseLogin {
   ok: boolean;
   role: string;
   username: string;
+  token?: string;      // Solo en /auth: "<id>.<secreto>"
+  expires_in?: number; // Segundos de vida del token
 }
\ No newline at end of file
@@ -0,0 +1,51 @@
+/* SPDX-License-Identifier: GPL-2.0 WITH Linux-syscall-note */
+/*
+ * include/uapi/linux/cpu_usage.h
+ * Estructuras de las syscalls de uso de CPU compartidas entre el kernel y
+ * los programas de usuario.
+ */
+#ifndef _UAPI_LINUX_CPU_USAGE_H
+#define _UAPI_LINUX_CPU_USAGE_H
+
+#include <linux/types.h>
+
+/* cpu_info_sample: el último muestreo del uso de CPU */
+struct cpu_usage_sample {
+	__u32 usage_x100; /* Uso de CPU x100 (10000 = 100.00%) */
+	__u32 window_ms;  /* Largo de la ventana medida (0 = promedio desde el arranque) */
+	__u64 age_ns;     /* Hace cuánto se tomó la muestra */
+};
+
+/* cpu_info_stats: estados de cada núcleo, en el orden de /proc/stat */
+enum cpu_usage_state {
+	CPU_STATE_USER,
+	CPU_STATE_NICE,
+	CPU_STATE_SYSTEM,
+	CPU_STATE_IRQ,
+	CPU_STATE_SOFTIRQ,
+	CPU_STATE_STEAL,
+	CPU_STATE_IOWAIT,
+	CPU_STATE_IDLE,
+	CPU_STATE_NR,
+};
+
+#define CPU_USAGE_STATS_VERSION 1
+
+/* cpu_info_stats: un núcleo */
+struct cpu_usage_stat {
+	__u32 cpu;                  /* Número de CPU */
+	__u32 __pad;
+	__u64 delta[CPU_STATE_NR];  /* Nanosegundos en cada estado durante la ventana */
+};
+
+/* cpu_info_stats: cabecera que se pasa a la syscall */
+struct cpu_usage_stats {
+	__u32 version;     /* entrada: CPU_USAGE_STATS_VERSION */
+	__u32 nr_entries;  /* entrada: capacidad de 'entries'; salida: entradas escritas */
+	__u64 entries;     /* struct cpu_usage_stat * (0 = solo consultar cuántos núcleos hay) */
+	__u32 window_ms;   /* salida: largo de la ventana medida */
+	__u32 __pad;
+	__u64 age_ns;      /* salida: hace cuánto se tomó la muestra */
+};
+
+#endif /* _UAPI_LINUX_CPU_USAGE_H */
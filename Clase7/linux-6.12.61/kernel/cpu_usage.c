@@ -1,10 +1,44 @@
 #include <linux/kernel.h>
 #include <linux/syscalls.h>
 #include <linux/uaccess.h>     // Necesario para mover datos entre Kernel y Usuario (put_user)
-#include <linux/delay.h>       // Necesario para msleep()
 #include <linux/kernel_stat.h> // Necesario para acceder a kcpustat_cpu()
 #include <linux/sched/cputime.h>
 #include <linux/cpumask.h>
+#include <linux/workqueue.h>   // delayed_work: el muestreo corre en segundo plano
+#include <linux/seqlock.h>     // Lecturas consistentes del último muestreo sin bloquear
+#include <linux/moduleparam.h>
+#include <linux/ktime.h>
+#include <linux/init.h>
+#include <linux/percpu.h>      // Última muestra y delta de cada núcleo
+#include <linux/slab.h>        // kvmalloc_array para el buffer de cpu_info_stats
+#include <uapi/linux/cpu_usage.h>
+
+/*
+ * Ventana de muestreo en milisegundos. Se puede cambiar en caliente:
+ *   echo 250 | sudo tee /sys/module/cpu_usage/parameters/sample_ms
+ * El nuevo valor se usa a partir del siguiente muestreo.
+ */
+static unsigned int cpu_sample_ms = 100;
+module_param_named(sample_ms, cpu_sample_ms, uint, 0644);
+MODULE_PARM_DESC(sample_ms, "Ventana de muestreo del uso de CPU en milisegundos (10-10000)");
+
+/*
+ * Helper: read_cpu_states
+ * Lee los contadores de UN núcleo en el orden de enum cpu_usage_state.
+ */
+static void read_cpu_states(int cpu, u64 st[CPU_STATE_NR])
+{
+    const struct kernel_cpustat *kcs = &kcpustat_cpu(cpu);
+
+    st[CPU_STATE_USER]    = kcs->cpustat[CPUTIME_USER];
+    st[CPU_STATE_NICE]    = kcs->cpustat[CPUTIME_NICE];
+    st[CPU_STATE_SYSTEM]  = kcs->cpustat[CPUTIME_SYSTEM];
+    st[CPU_STATE_IRQ]     = kcs->cpustat[CPUTIME_IRQ];
+    st[CPU_STATE_SOFTIRQ] = kcs->cpustat[CPUTIME_SOFTIRQ];
+    st[CPU_STATE_STEAL]   = kcs->cpustat[CPUTIME_STEAL];
+    st[CPU_STATE_IOWAIT]  = kcs->cpustat[CPUTIME_IOWAIT];
+    st[CPU_STATE_IDLE]    = kcs->cpustat[CPUTIME_IDLE];
+}
 
 /*
  * Helper: read_cpu_times
@@ -40,27 +74,42 @@ static void read_cpu_times(u64 *idle, u64 *total)
 }
 
 /*
- * Helper: get_cpu_percent_x100
- * Calcula el uso de CPU comparando dos momentos en el tiempo.
- * Retorna un valor de 0 a 10000 (donde 10000 es 100.00%).
+ * ESTADO DEL MUESTREADOR
+ * Antes cada llamada dormía 100ms entre dos lecturas. Ahora un trabajo en
+ * segundo plano (delayed_work) toma una muestra cada sample_ms y guarda el
+ * último porcentaje; la syscall solo lo copia (microsegundos, sin dormir).
+ * El seqlock permite que muchos lectores lean a la vez sin bloquear al escritor.
  */
-static u32 get_cpu_percent_x100(void)
-{
-    u64 idle1, total1, idle2, total2;
-    s64 didle, dtotal;
+static DEFINE_SEQLOCK(cpu_sample_lock);
+static u32 cpu_sample_percent;   // Último porcentaje x100 calculado
+static u64 cpu_sample_time_ns;   // Cuándo se calculó (ktime_get_ns)
+static u32 cpu_sample_window_ms; // Largo real de la ventana usada
+static u64 cpu_prev_idle, cpu_prev_total, cpu_prev_time_ns; // Muestra anterior (solo el trabajo las toca)
 
-    // 1. TOMA DE MUESTRA INICIAL (T0)
-    read_cpu_times(&idle1, &total1);
+/*
+ * Desglose por núcleo: la muestra anterior (solo la toca el trabajo) y el
+ * delta de la última ventana (se publica bajo cpu_sample_lock).
+ */
+struct cpu_state_snap {
+    u64 prev[CPU_STATE_NR];
+    u64 delta[CPU_STATE_NR];
+    bool seen; // false hasta la primera muestra de este núcleo (ej. recién encendido)
+};
+static DEFINE_PER_CPU(struct cpu_state_snap, cpu_state_snap);
 
-    // 2. INTERVALO DE MUESTREO
-    // Dormimos el proceso por 100ms. Sin esto, la diferencia sería 0 o irrelevante.
-    // ADVERTENCIA: Esto bloquea al proceso que llamó a la syscall.
-    msleep(100); 
+static void cpu_sampler_fn(struct work_struct *work);
+static DECLARE_DELAYED_WORK(cpu_sampler_work, cpu_sampler_fn);
 
-    // 3. TOMA DE MUESTRA FINAL (T1)
-    read_cpu_times(&idle2, &total2);
+/*
+ * Helper: percent_x100
+ * Calcula el uso de CPU entre dos muestras.
+ * Retorna un valor de 0 a 10000 (donde 10000 es 100.00%).
+ */
+static u32 percent_x100(u64 idle1, u64 total1, u64 idle2, u64 total2)
+{
+    s64 didle, dtotal;
 
-    // 4. CÁLCULO DEL DELTA (Diferencia entre T1 y T0)
+    // CÁLCULO DEL DELTA (Diferencia entre T1 y T0)
     // Casteamos a s64 (signed) por seguridad en la resta
     didle  = (s64)idle2  - (s64)idle1;
     dtotal = (s64)total2 - (s64)total1;
@@ -69,13 +118,91 @@ static u32 get_cpu_percent_x100(void)
     if (dtotal <= 0)
         return 0;
 
-    // 5. CÁLCULO DEL PORCENTAJE
+    // CÁLCULO DEL PORCENTAJE
     // Fórmula: (Actividad / Total) -> ((Total - Idle) / Total)
     // Multiplicamos por 10000ULL para manejar 2 decimales usando enteros (Fixed Point).
     // Usamos div64_u64 para dividir números de 64 bits de forma segura en el kernel.
     return (u32)div64_u64((u64)(dtotal - didle) * 10000ULL, (u64)dtotal);
 }
 
+/*
+ * Trabajo periódico: toma una muestra, calcula el porcentaje contra la
+ * muestra anterior, lo publica y se vuelve a programar.
+ */
+static void cpu_sampler_fn(struct work_struct *work)
+{
+    u64 idle = 0, total = 0, now = ktime_get_ns();
+    u64 st[CPU_STATE_NR];
+    unsigned int ms;
+    int cpu, i;
+
+    write_seqlock(&cpu_sample_lock);
+
+    // Una sola pasada por los núcleos: sirve para el total y para el desglose
+    for_each_online_cpu(cpu) {
+        struct cpu_state_snap *snap = per_cpu_ptr(&cpu_state_snap, cpu);
+
+        read_cpu_states(cpu, st);
+        for (i = 0; i < CPU_STATE_NR; i++) {
+            snap->delta[i] = snap->seen ? st[i] - snap->prev[i] : 0;
+            snap->prev[i] = st[i];
+            total += st[i];
+        }
+        snap->seen = true;
+        idle += st[CPU_STATE_IDLE];
+    }
+
+    if (cpu_prev_time_ns) {
+        cpu_sample_percent = percent_x100(cpu_prev_idle, cpu_prev_total, idle, total);
+        cpu_sample_time_ns = now;
+        cpu_sample_window_ms = (u32)div_u64(now - cpu_prev_time_ns, NSEC_PER_MSEC);
+    }
+    write_sequnlock(&cpu_sample_lock);
+
+    cpu_prev_idle = idle;
+    cpu_prev_total = total;
+    cpu_prev_time_ns = now;
+
+    // Leemos el parámetro en cada vuelta: así se puede cambiar sin reiniciar
+    ms = clamp_t(unsigned int, READ_ONCE(cpu_sample_ms), 10, 10000);
+    // system_power_efficient_wq: el trabajo no necesita una CPU fija
+    queue_delayed_work(system_power_efficient_wq, &cpu_sampler_work, msecs_to_jiffies(ms));
+}
+
+static int __init cpu_sampler_init(void)
+{
+    queue_delayed_work(system_power_efficient_wq, &cpu_sampler_work, 0);
+    return 0;
+}
+late_initcall(cpu_sampler_init);
+
+/*
+ * Helper: get_cpu_sample
+ * Lee el último muestreo de forma consistente (sin bloquear).
+ * Si todavía no hay ninguno (justo al arrancar), usa el promedio desde el arranque.
+ */
+static void get_cpu_sample(struct cpu_usage_sample *sample)
+{
+    unsigned int seq;
+    u64 time_ns, idle, total;
+
+    do {
+        seq = read_seqbegin(&cpu_sample_lock);
+        sample->usage_x100 = cpu_sample_percent;
+        sample->window_ms = cpu_sample_window_ms;
+        time_ns = cpu_sample_time_ns;
+    } while (read_seqretry(&cpu_sample_lock, seq));
+
+    if (!time_ns) {
+        read_cpu_times(&idle, &total);
+        sample->usage_x100 = percent_x100(0, 0, idle, total);
+        sample->window_ms = 0;
+        sample->age_ns = 0;
+        return;
+    }
+    sample->age_ns = ktime_get_ns() - time_ns;
+}
+
 /*
  * SYSCALL_DEFINE1: Macro para definir la llamada al sistema.
  * - Nombre: cpu_info
@@ -84,22 +211,110 @@ static u32 get_cpu_percent_x100(void)
  */
 SYSCALL_DEFINE1(cpu_info, int __user *, cpu_usage_out)
 {
-    u32 cpu;
+    struct cpu_usage_sample sample;
 
     // 1. VALIDACIÓN DE PUNTEROS
     // Si el usuario pasa NULL, retornamos error de argumento inválido.
     if (!cpu_usage_out)
         return -EINVAL;
 
-    // 2. EJECUCIÓN LÓGICA (Bloqueante por 100ms)
-    cpu = get_cpu_percent_x100();
+    // 2. EJECUCIÓN LÓGICA (ya no bloquea: copia el último muestreo)
+    get_cpu_sample(&sample);
 
     // 3. TRANSFERENCIA AL USUARIO
-    // put_user intenta escribir el valor 'cpu' en la dirección 'cpu_usage_out'.
+    // put_user intenta escribir el valor en la dirección 'cpu_usage_out'.
     // Verifica permisos de escritura y manejo de memoria virtual.
     // Retorna -EFAULT si la dirección de memoria es inválida.
-    if (put_user((int)cpu, cpu_usage_out))
+    if (put_user((int)sample.usage_x100, cpu_usage_out))
         return -EFAULT;
 
     return 0; // Éxito (convención de retorno en C/Linux)
-}
\ No newline at end of file
+}
+
+/*
+ * SYSCALL_DEFINE1: cpu_info_sample
+ * Igual que cpu_info pero devuelve también la antigüedad de la muestra
+ * y el largo de la ventana con la que se calculó.
+ */
+SYSCALL_DEFINE1(cpu_info_sample, struct cpu_usage_sample __user *, sample_out)
+{
+    struct cpu_usage_sample sample;
+
+    if (!sample_out)
+        return -EINVAL;
+
+    get_cpu_sample(&sample);
+
+    // copy_to_user: como put_user pero para una estructura completa
+    if (copy_to_user(sample_out, &sample, sizeof(sample)))
+        return -EFAULT;
+
+    return 0;
+}
+
+/*
+ * SYSCALL_DEFINE1: cpu_info_stats
+ * Desglose por núcleo y por estado de la última ventana, en una sola llamada
+ * (en vez de leer y parsear /proc/stat).
+ * - El usuario indica la versión y cuántas entradas caben en su buffer.
+ * - Se llenan como máximo nr_entries; si entries es 0 solo se consulta.
+ * - Retorna la cantidad de núcleos en línea (si es mayor que nr_entries,
+ *   el buffer quedó corto y la lista está truncada).
+ */
+SYSCALL_DEFINE1(cpu_info_stats, struct cpu_usage_stats __user *, stats_out)
+{
+    struct cpu_usage_stats hdr;
+    struct cpu_usage_stat *buf = NULL;
+    struct cpu_usage_sample sample;
+    u32 cap, n;
+    unsigned int seq;
+    int cpu;
+    long ret;
+
+    // 1. VALIDACIÓN: la cabecera debe traer una versión que conozcamos
+    if (!stats_out)
+        return -EINVAL;
+    if (copy_from_user(&hdr, stats_out, sizeof(hdr)))
+        return -EFAULT;
+    if (hdr.version != CPU_USAGE_STATS_VERSION)
+        return -EINVAL;
+
+    cap = hdr.entries ? min_t(u32, hdr.nr_entries, nr_cpu_ids) : 0;
+    if (cap) {
+        buf = kvmalloc_array(cap, sizeof(*buf), GFP_KERNEL);
+        if (!buf)
+            return -ENOMEM;
+    }
+
+    // 2. COPIA CONSISTENTE: todos los núcleos de la misma ventana
+    do {
+        seq = read_seqbegin(&cpu_sample_lock);
+        n = 0;
+        for_each_online_cpu(cpu) {
+            const struct cpu_state_snap *snap = per_cpu_ptr(&cpu_state_snap, cpu);
+
+            if (n < cap) {
+                buf[n].cpu = cpu;
+                buf[n].__pad = 0;
+                memcpy(buf[n].delta, snap->delta, sizeof(buf[n].delta));
+            }
+            n++;
+        }
+    } while (read_seqretry(&cpu_sample_lock, seq));
+
+    get_cpu_sample(&sample);
+    hdr.nr_entries = min(n, cap);
+    hdr.window_ms = sample.window_ms;
+    hdr.__pad = 0;
+    hdr.age_ns = sample.age_ns;
+
+    // 3. TRANSFERENCIA AL USUARIO (fuera del seqlock: copy_to_user puede dormir)
+    ret = n;
+    if (cap && copy_to_user(u64_to_user_ptr(hdr.entries), buf, hdr.nr_entries * sizeof(*buf)))
+        ret = -EFAULT;
+    else if (copy_to_user(stats_out, &hdr, sizeof(hdr)))
+        ret = -EFAULT;
+
+    kvfree(buf);
+    return ret;
+}
@@ -1,8 +1,49 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
 #include <unistd.h>
 #include <sys/syscall.h>
 
+#include "linux-6.12.61/include/uapi/linux/cpu_usage.h"
+
 #define SYS_CPU_USAGE 551
+#define SYS_CPU_USAGE_SAMPLE 556
+#define SYS_CPU_USAGE_STATS 557
+
+// Imprime el desglose por núcleo de la última ventana (% de cada estado)
+static void printCpuStats(void) {
+    const char *names[CPU_STATE_NR] = {"user", "nice", "sys", "irq", "sirq", "steal", "iowait", "idle"};
+    struct cpu_usage_stats stats = { .version = CPU_USAGE_STATS_VERSION };
+    long ncpu = sysconf(_SC_NPROCESSORS_CONF);
+    struct cpu_usage_stat *cpus = calloc(ncpu, sizeof(*cpus));
+
+    if (!cpus)
+        return;
+    stats.nr_entries = ncpu;
+    stats.entries = (uint64_t)(uintptr_t)cpus;
+
+    long n = syscall(SYS_CPU_USAGE_STATS, &stats);
+    if (n < 0) {
+        perror("Error en syscall cpu_info_stats");
+        free(cpus);
+        return;
+    }
+    printf("%ld CPUs en línea, ventana %u ms\n", n, stats.window_ms);
+    printf("%-5s", "cpu");
+    for (int s = 0; s < CPU_STATE_NR; s++)
+        printf(" %7s", names[s]);
+    printf("\n");
+    for (unsigned int i = 0; i < stats.nr_entries; i++) {
+        uint64_t total = 0;
+        for (int s = 0; s < CPU_STATE_NR; s++)
+            total += cpus[i].delta[s];
+        printf("%-5u", cpus[i].cpu);
+        for (int s = 0; s < CPU_STATE_NR; s++)
+            printf(" %6.1f%%", total ? 100.0 * cpus[i].delta[s] / total : 0.0);
+        printf("\n");
+    }
+    free(cpus);
+}
 
 
 int main(){
@@ -17,6 +58,18 @@ int main(){
     } else {
         perror("Error en syscall");
     }
+
+    // Misma medición, con la antigüedad de la muestra y el largo de la ventana
+    struct cpu_usage_sample sample;
+    if (syscall(SYS_CPU_USAGE_SAMPLE, &sample) == 0) {
+        printf("CPU Usage: %u.%02u%% (ventana %u ms, hace %llu us)\n",
+               sample.usage_x100 / 100, sample.usage_x100 % 100, sample.window_ms,
+               (unsigned long long)(sample.age_ns / 1000));
+    } else {
+        perror("Error en syscall cpu_info_sample");
+    }
+
+    printCpuStats();
     
  
   return 0;
@@ -0,0 +1,415 @@
+/*
+ * Benchmark no interactivo de la syscall my_encrypt (548).
+ *
+ * Genera archivos de entrada para varios tamaños y archivos de clave para
+ * varios largos, y llama a la syscall con 1 .. 2x(CPUs) hilos. Cada
+ * combinación se repite con la page cache caliente (la entrada ya está en
+ * memoria) y fría (se vacía antes de cada repetición).
+ *
+ * Por combinación reporta MB/s (sobre la mediana), latencia p50/p99 y la
+ * eficiencia de escalado respecto a 1 hilo, en CSV o JSON:
+ *   eficiencia = (MB/s con N hilos / MB/s con 1 hilo) / N
+ *
+ * Compilar: gcc -O2 -o bench_encrypt bench_encrypt.c -lpthread
+ * Ejecutar: ./bench_encrypt [opciones] > resultados.csv
+ *   -d DIR      Carpeta para los archivos de prueba (por defecto /tmp/encrypt_bench)
+ *   -s LISTA    Tamaños de entrada, p. ej. 4K,1M,256M,4G (por defecto 4K,64K,1M,16M,256M,1G)
+ *   -k LISTA    Largos de clave en bytes (por defecto 1,16,256,4096)
+ *   -t N        Máximo de hilos (por defecto 2 x CPUs en línea)
+ *   -r N        Repeticiones por combinación (por defecto 5)
+ *   -c MODOS    warm, cold o warm,cold (por defecto warm,cold)
+ *   -f FORMATO  csv o json (por defecto csv)
+ *   -e MOTORES  kernel, user o kernel,user (por defecto kernel); user = encrypt_user.h
+ *   -a ALGS     xor, aes-ctr, chacha20 separados por coma (por defecto xor)
+ *
+ * AES-CTR y ChaCha20 van por my_encrypt_ex (553) con una clave de 32 bytes
+ * + 16 de IV; -k solo aplica al XOR. El motor de usuario solo hace XOR.
+ *
+ * La caché fría usa /proc/sys/vm/drop_caches (necesita root). Sin permisos
+ * se usa posix_fadvise(POSIX_FADV_DONTNEED) sobre la entrada, que solo
+ * descarta las páginas de ese archivo.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#include "encrypt_user.h"
+
+#define MY_ENCRYPT 548
+#define MY_ENCRYPT_EX 553
+
+#define MAX_LIST 32
+#define GEN_BLOCK (1 << 20)
+
+enum cache_mode { CACHE_WARM, CACHE_COLD };
+static const char *cache_names[] = { "warm", "cold" };
+
+enum engine { ENGINE_KERNEL, ENGINE_USER };
+static const char *engine_names[] = { "kernel", "user" };
+
+enum algorithm { ALG_XOR, ALG_AES_CTR, ALG_CHACHA20, ALG_NR };
+static const char *alg_names[] = { "xor", "aes-ctr", "chacha20" };
+static const unsigned int alg_flags[] = { MY_ENCRYPT_ALG_XOR, MY_ENCRYPT_ALG_AES_CTR, MY_ENCRYPT_ALG_CHACHA20 };
+
+// Clave de los cifrados reales: AES-256 / ChaCha20 (32 bytes) + IV
+#define CIPHER_KEY_BYTES 32
+
+struct result {
+    enum engine engine;
+    enum algorithm alg;
+    unsigned long long size;
+    unsigned int key_length;
+    int threads;
+    enum cache_mode cache;
+    int reps;
+    double mb_s;
+    double p50_ms;
+    double p99_ms;
+    double efficiency;
+};
+
+static struct result *results;
+static size_t nr_results, results_cap;
+
+// Una llamada al motor elegido; -1 y errno como syscall()
+static long encrypt_once(enum engine engine, enum algorithm alg, const char *input, const char *output,
+                         const char *key, int threads) {
+    int ret;
+
+    if (engine == ENGINE_KERNEL && alg != ALG_XOR)
+        return syscall(MY_ENCRYPT_EX, input, output, key, threads, alg_flags[alg]);
+    if (engine == ENGINE_KERNEL)
+        return syscall(MY_ENCRYPT, input, output, key, threads);
+    ret = encrypt_file_user(input, output, key, threads, alg_flags[alg]);
+    if (ret < 0) {
+        errno = -ret;
+        return -1;
+    }
+    return 0;
+}
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// "4K,1M,2G" -> {4096, 1048576, 2147483648}
+static int parse_sizes(const char *text, unsigned long long *out, int max) {
+    char *copy = strdup(text), *save = NULL;
+    int n = 0;
+
+    for (char *tok = strtok_r(copy, ",", &save); tok && n < max; tok = strtok_r(NULL, ",", &save)) {
+        char *end;
+        unsigned long long v = strtoull(tok, &end, 10);
+        switch (*end) {
+            case 'k': case 'K': v <<= 10; break;
+            case 'm': case 'M': v <<= 20; break;
+            case 'g': case 'G': v <<= 30; break;
+        }
+        if (v)
+            out[n++] = v;
+    }
+    free(copy);
+    return n;
+}
+
+// Generador rápido y reproducible (xorshift64*): los datos no importan, solo que no sean ceros
+static uint64_t next_random(uint64_t *state) {
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 2685821657736338717ULL;
+}
+
+// Crea el archivo con 'size' bytes, salvo que ya exista con ese tamaño
+static int make_file(const char *path, unsigned long long size, uint64_t seed) {
+    static uint64_t block[GEN_BLOCK / sizeof(uint64_t)];
+    struct stat st;
+    int fd;
+
+    if (stat(path, &st) == 0 && (unsigned long long)st.st_size == size)
+        return 0;
+
+    fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        perror(path);
+        return -1;
+    }
+    for (unsigned long long done = 0; done < size; ) {
+        size_t len = size - done < GEN_BLOCK ? size - done : GEN_BLOCK;
+        for (size_t i = 0; i < (len + 7) / 8; i++)
+            block[i] = next_random(&seed);
+        ssize_t w = write(fd, block, len);
+        if (w <= 0) {
+            perror(path);
+            close(fd);
+            return -1;
+        }
+        done += w;
+    }
+    fsync(fd);
+    close(fd);
+    return 0;
+}
+
+// Vacía la page cache antes de una repetición en frío
+static void drop_cache(const char *input) {
+    static bool warned;
+    int fd;
+
+    sync();
+    fd = open("/proc/sys/vm/drop_caches", O_WRONLY);
+    if (fd >= 0) {
+        bool ok = write(fd, "3", 1) == 1;
+        close(fd);
+        if (ok)
+            return;
+    }
+
+    // Sin root: al menos se descartan las páginas de la entrada
+    if (!warned) {
+        fprintf(stderr, "Aviso: sin acceso a drop_caches, se usa posix_fadvise sobre la entrada\n");
+        warned = true;
+    }
+    fd = open(input, O_RDONLY);
+    if (fd >= 0) {
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        close(fd);
+    }
+}
+
+// Lee el archivo completo para dejarlo en la page cache
+static void warm_cache(const char *path) {
+    static char buf[GEN_BLOCK];
+    int fd = open(path, O_RDONLY);
+
+    if (fd < 0)
+        return;
+    while (read(fd, buf, sizeof(buf)) > 0)
+        ;
+    close(fd);
+}
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Percentil por rango más cercano sobre un arreglo ordenado
+static double percentile(const double *sorted, int n, double p) {
+    int rank = (int)(p / 100.0 * n + 0.999999);
+    if (rank < 1)
+        rank = 1;
+    if (rank > n)
+        rank = n;
+    return sorted[rank - 1];
+}
+
+static void add_result(struct result r) {
+    if (nr_results == results_cap) {
+        results_cap = results_cap ? results_cap * 2 : 64;
+        results = realloc(results, results_cap * sizeof(*results));
+        if (!results) {
+            fprintf(stderr, "Sin memoria para los resultados\n");
+            exit(1);
+        }
+    }
+    results[nr_results++] = r;
+}
+
+// Busca la medición con 1 hilo de la misma combinación (para la eficiencia)
+static const struct result *find_single(enum engine engine, enum algorithm alg, unsigned long long size,
+                                       unsigned int key_length, enum cache_mode cache) {
+    for (size_t i = 0; i < nr_results; i++) {
+        const struct result *r = &results[i];
+        if (r->engine == engine && r->alg == alg && r->size == size && r->key_length == key_length && r->cache == cache && r->threads == 1)
+            return r;
+    }
+    return NULL;
+}
+
+/*
+ * Una combinación: 'reps' llamadas medidas. En caliente se hace antes una
+ * llamada sin medir (y se lee la entrada) para que todo esté en memoria.
+ */
+static int run_case(enum engine engine, enum algorithm alg, const char *input, const char *output, const char *key, unsigned long long size,
+                    unsigned int key_length, int threads, enum cache_mode cache, int reps) {
+    double *lat = malloc(reps * sizeof(double));
+    struct result r = { engine, alg, size, key_length, threads, cache, reps, 0, 0, 0, 0 };
+    const struct result *single;
+    int err;
+
+    if (!lat)
+        return -1;
+
+    if (cache == CACHE_WARM) {
+        warm_cache(input);
+        if (encrypt_once(engine, alg, input, output, key, threads) < 0)
+            goto fail;
+    }
+
+    for (int i = 0; i < reps; i++) {
+        if (cache == CACHE_COLD)
+            drop_cache(input);
+        double t0 = now_sec();
+        long ret = encrypt_once(engine, alg, input, output, key, threads);
+        lat[i] = now_sec() - t0;
+        if (ret < 0)
+            goto fail;
+    }
+
+    qsort(lat, reps, sizeof(double), cmp_double);
+    r.p50_ms = percentile(lat, reps, 50) * 1e3;
+    r.p99_ms = percentile(lat, reps, 99) * 1e3;
+    r.mb_s = size / percentile(lat, reps, 50) / 1e6;
+    single = find_single(engine, alg, size, key_length, cache);
+    r.efficiency = single ? r.mb_s / single->mb_s / threads : 1.0;
+    add_result(r);
+
+    fprintf(stderr, "%-6s %-8s %12llu B  clave %5u  %3d hilos  %s  %10.1f MB/s  p50 %9.3f ms  p99 %9.3f ms  ef %.2f\n",
+            engine_names[engine], alg_names[alg], size, key_length, threads, cache_names[cache], r.mb_s, r.p50_ms, r.p99_ms, r.efficiency);
+    free(lat);
+    return 0;
+
+fail:
+    err = errno;
+    fprintf(stderr, "my_encrypt (%s, %s) falló (%s, %d hilos): %s\n", engine_names[engine], alg_names[alg], input, threads, strerror(err));
+    free(lat);
+    return err == ENOSYS ? -ENOSYS : 0;
+}
+
+static void print_csv(FILE *out) {
+    fprintf(out, "engine,alg,size_bytes,key_bytes,threads,cache,reps,mb_s,p50_ms,p99_ms,efficiency\n");
+    for (size_t i = 0; i < nr_results; i++) {
+        const struct result *r = &results[i];
+        fprintf(out, "%s,%s,%llu,%u,%d,%s,%d,%.1f,%.3f,%.3f,%.3f\n", engine_names[r->engine], alg_names[r->alg], r->size, r->key_length, r->threads,
+                cache_names[r->cache], r->reps, r->mb_s, r->p50_ms, r->p99_ms, r->efficiency);
+    }
+}
+
+static void print_json(FILE *out) {
+    fprintf(out, "[\n");
+    for (size_t i = 0; i < nr_results; i++) {
+        const struct result *r = &results[i];
+        fprintf(out, "  {\"engine\": \"%s\", \"alg\": \"%s\", \"size_bytes\": %llu, \"key_bytes\": %u, \"threads\": %d, \"cache\": \"%s\", "
+                     "\"reps\": %d, \"mb_s\": %.1f, \"p50_ms\": %.3f, \"p99_ms\": %.3f, \"efficiency\": %.3f}%s\n",
+                engine_names[r->engine], alg_names[r->alg], r->size, r->key_length, r->threads, cache_names[r->cache], r->reps, r->mb_s,
+                r->p50_ms, r->p99_ms, r->efficiency, i + 1 < nr_results ? "," : "");
+    }
+    fprintf(out, "]\n");
+}
+
+int main(int argc, char **argv) {
+    const char *dir = "/tmp/encrypt_bench", *format = "csv";
+    unsigned long long sizes[MAX_LIST], key_lengths[MAX_LIST];
+    int nr_sizes = parse_sizes("4K,64K,1M,16M,256M,1G", sizes, MAX_LIST);
+    int nr_keys = parse_sizes("1,16,256,4096", key_lengths, MAX_LIST);
+    int max_threads = 2 * (int)sysconf(_SC_NPROCESSORS_ONLN), reps = 5;
+    bool modes[2] = { true, true }, engines[2] = { true, false }, algs[ALG_NR] = { true, false, false };
+    char input[4096], output[4096], key[4096];
+    int opt;
+
+    while ((opt = getopt(argc, argv, "d:s:k:t:r:c:f:e:a:")) != -1) {
+        switch (opt) {
+            case 'd': dir = optarg; break;
+            case 's': nr_sizes = parse_sizes(optarg, sizes, MAX_LIST); break;
+            case 'k': nr_keys = parse_sizes(optarg, key_lengths, MAX_LIST); break;
+            case 't': max_threads = atoi(optarg); break;
+            case 'r': reps = atoi(optarg); break;
+            case 'c':
+                modes[CACHE_WARM] = strstr(optarg, "warm") != NULL;
+                modes[CACHE_COLD] = strstr(optarg, "cold") != NULL;
+                break;
+            case 'f': format = optarg; break;
+            case 'e':
+                engines[ENGINE_KERNEL] = strstr(optarg, "kernel") != NULL;
+                engines[ENGINE_USER] = strstr(optarg, "user") != NULL;
+                break;
+            case 'a':
+                for (int a = 0; a < ALG_NR; a++)
+                    algs[a] = strstr(optarg, alg_names[a]) != NULL;
+                break;
+            default:
+                fprintf(stderr, "Uso: %s [-d dir] [-s tamaños] [-k claves] [-t hilos] [-r reps] [-c warm,cold] [-f csv|json] [-e kernel,user] [-a xor,aes-ctr,chacha20]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (max_threads < 1 || reps < 1 || !nr_sizes || !nr_keys || (!modes[0] && !modes[1]) || (!engines[0] && !engines[1]) ||
+        (!algs[ALG_XOR] && !algs[ALG_AES_CTR] && !algs[ALG_CHACHA20])) {
+        fprintf(stderr, "Parámetros inválidos\n");
+        return 1;
+    }
+
+    // 1. ARCHIVOS DE PRUEBA (se reutilizan entre corridas si ya existen)
+    if (mkdir(dir, 0755) < 0 && errno != EEXIST) {
+        perror(dir);
+        return 1;
+    }
+    for (int k = 0; k < nr_keys; k++) {
+        snprintf(key, sizeof(key), "%s/key_%llu", dir, key_lengths[k]);
+        if (make_file(key, key_lengths[k], 0x5eed0000 + key_lengths[k]) < 0)
+            return 1;
+    }
+    for (int a = ALG_AES_CTR; a < ALG_NR; a++) {
+        snprintf(key, sizeof(key), "%s/key_%s", dir, alg_names[a]);
+        if (make_file(key, CIPHER_KEY_BYTES + MY_ENCRYPT_IV_SIZE, 0xae5 + a) < 0)
+            return 1;
+    }
+    snprintf(output, sizeof(output), "%s/output", dir);
+
+    // 2. BARRIDO: tamaño x algoritmo x clave x motor x caché x hilos (1, 2, 4, ... y siempre el máximo)
+    for (int s = 0; s < nr_sizes; s++) {
+        snprintf(input, sizeof(input), "%s/input_%llu", dir, sizes[s]);
+        fprintf(stderr, "Generando %s ...\n", input);
+        if (make_file(input, sizes[s], 548 + sizes[s]) < 0)
+            return 1;
+
+        for (int a = 0; a < ALG_NR; a++) {
+            if (!algs[a])
+                continue;
+            // El XOR se mide con cada largo de clave; los cifrados con su clave fija
+            for (int k = 0; k < (a == ALG_XOR ? nr_keys : 1); k++) {
+                unsigned int key_length = a == ALG_XOR ? key_lengths[k] : CIPHER_KEY_BYTES;
+
+                if (a == ALG_XOR)
+                    snprintf(key, sizeof(key), "%s/key_%llu", dir, key_lengths[k]);
+                else
+                    snprintf(key, sizeof(key), "%s/key_%s", dir, alg_names[a]);
+                for (int e = ENGINE_KERNEL; e <= ENGINE_USER; e++) {
+                    // El motor de usuario solo implementa el XOR
+                    if (!engines[e] || (e == ENGINE_USER && a != ALG_XOR))
+                        continue;
+                    for (int c = CACHE_WARM; c <= CACHE_COLD; c++) {
+                        if (!modes[c])
+                            continue;
+                        for (int t = 1; t <= max_threads; t = (t * 2 > max_threads && t < max_threads) ? max_threads : t * 2) {
+                            if (run_case(e, a, input, output, key, sizes[s], key_length, t, c, reps) == -ENOSYS) {
+                                fprintf(stderr, "La syscall %d no existe en este kernel (probar con -e user)\n",
+                                        a == ALG_XOR ? MY_ENCRYPT : MY_ENCRYPT_EX);
+                                return 1;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+        unlink(output);
+    }
+
+    // 3. RESULTADOS
+    if (strcmp(format, "json") == 0)
+        print_json(stdout);
+    else
+        print_csv(stdout);
+    free(results);
+    return 0;
+}
@@ -0,0 +1,245 @@
+/*
+ * encrypt_user.h
+ * Motor de cifrado en espacio de usuario, compatible con my_encrypt.
+ *
+ * Para los equipos que no corren el kernel con la syscall 548: el archivo
+ * de entrada se mapea con mmap y un grupo de pthreads aplica el mismo XOR
+ * con clave repetida (encrypt_xor.h), así que la salida es idéntica byte a
+ * byte a la del kernel.
+ *
+ * Cada hilo cifra un rango de páginas completas: lee de la entrada mapeada
+ * (sin read(), directo de la page cache, como el modo zero-copy del kernel),
+ * deja el resultado en un buffer propio de USER_BLOCK bytes que cabe en la
+ * caché del CPU y lo escribe con pwrite() en su posición. Escribir con
+ * pwrite() en vez de mapear también la salida evita un fallo de página por
+ * cada página escrita.
+ *
+ * Mismas reglas que la syscall: devuelve 0 o -errno, la clave es el archivo
+ * completo, una entrada o clave vacía es -EINVAL y la salida se abre solo para
+ * escritura, con 0644 y O_TRUNC. Con MY_ENCRYPT_F_INPLACE se cifra la entrada sobre sí misma.
+ * Solo implementa el XOR: con MY_ENCRYPT_ALG_AES_CTR o _CHACHA20 devuelve -EOPNOTSUPP.
+ */
+#ifndef _ENCRYPT_USER_H
+#define _ENCRYPT_USER_H
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "linux-6.12.61/include/uapi/linux/my_encrypt.h"
+#include "linux-6.12.61/kernel/encrypt_xor.h"
+
+// Bloque que cada hilo cifra y escribe de una vez
+#define USER_BLOCK (256 * 1024)
+
+// Una parte del archivo para un hilo (como DataFragment en el kernel)
+struct user_fragment {
+    const unsigned char *src;   // Entrada mapeada
+    int output_fd;              // Salida (== la entrada en modo in-place)
+    size_t start, end;          // Rango [start, end) dentro del archivo
+    const unsigned char *key_stream;
+    size_t key_span;
+    size_t key_length;
+    int status;                 // 0 o -errno
+    pthread_t thread;
+    bool started;               // false = la parte la hizo el hilo que llamó
+};
+
+static void *user_xor_fragment(void *arg) {
+    struct user_fragment *f = arg;
+    size_t key_pos = f->start % f->key_length;
+    unsigned char *buffer = malloc(USER_BLOCK);
+
+    if (!buffer) {
+        f->status = -ENOMEM;
+        return NULL;
+    }
+    // Cada hilo recorre su rango una sola vez, de principio a fin
+    madvise((void *)(f->src + f->start), f->end - f->start, MADV_SEQUENTIAL);
+
+    for (size_t pos = f->start; pos < f->end; ) {
+        size_t n = f->end - pos < USER_BLOCK ? f->end - pos : USER_BLOCK;
+        ssize_t w;
+
+        // En modo in-place el bloque ya se leyó completo antes de sobrescribirlo
+        key_pos = xor_stream_copy(buffer, f->src + pos, n, f->key_stream, f->key_span, key_pos);
+        for (size_t done = 0; done < n; done += w) {
+            w = pwrite(f->output_fd, buffer + done, n - done, pos + done);
+            if (w <= 0) {
+                f->status = w < 0 ? -errno : -EIO;
+                goto out;
+            }
+        }
+        pos += n;
+    }
+
+out:
+    explicit_bzero(buffer, USER_BLOCK);
+    free(buffer);
+    return NULL;
+}
+
+// Lee el archivo de clave completo y lo expande (ver encrypt_key_load en el kernel)
+static int user_key_load(const char *key_filepath, unsigned char **stream_out, size_t *span_out, size_t *length_out) {
+    struct stat st;
+    unsigned char *key, *stream;
+    ssize_t got = 0, r;
+    int fd = open(key_filepath, O_RDONLY);
+
+    if (fd < 0)
+        return -errno;
+    if (fstat(fd, &st) < 0 || st.st_size <= 0) {
+        close(fd);
+        return -EINVAL;
+    }
+    key = malloc(st.st_size);
+    if (!key) {
+        close(fd);
+        return -ENOMEM;
+    }
+    while (got < st.st_size && (r = read(fd, key + got, st.st_size - got)) > 0)
+        got += r;
+    close(fd);
+    if (got <= 0) {
+        free(key);
+        return -EINVAL;
+    }
+
+    stream = malloc(xor_key_span(got));
+    if (!stream) {
+        explicit_bzero(key, got);
+        free(key);
+        return -ENOMEM;
+    }
+    xor_key_expand(stream, key, got);
+    explicit_bzero(key, got);
+    free(key);
+
+    *stream_out = stream;
+    *span_out = xor_key_span(got);
+    *length_out = got;
+    return 0;
+}
+
+/*
+ * Cifra input_filepath en output_filepath (o sobre sí mismo con
+ * MY_ENCRYPT_F_INPLACE) usando thread_count hilos.
+ * MY_ENCRYPT_F_ZEROCOPY se acepta y no cambia nada: con mmap siempre se lee
+ * directo de la page cache.
+ */
+static int encrypt_file_user(const char *input_filepath, const char *output_filepath,
+                             const char *key_filepath, int thread_count, unsigned int flags) {
+    bool inplace = flags & MY_ENCRYPT_F_INPLACE;
+    size_t page = sysconf(_SC_PAGESIZE);
+    struct user_fragment *fragments = NULL;
+    unsigned char *key_stream = NULL, *src = MAP_FAILED;
+    size_t key_span = 0, key_length = 1, size = 0, pages, parts, first;
+    int input_fd, output_fd = -1, ret;
+    struct stat st;
+
+    if (thread_count <= 0 || (flags & ~MY_ENCRYPT_F_ALL))
+        return -EINVAL;
+    // AES-CTR y ChaCha20 solo existen en el kernel (crypto API)
+    if ((flags & MY_ENCRYPT_ALG_MASK) != MY_ENCRYPT_ALG_XOR)
+        return -EOPNOTSUPP;
+
+    // 1. CLAVE
+    ret = user_key_load(key_filepath, &key_stream, &key_span, &key_length);
+    if (ret < 0)
+        return ret;
+
+    // 2. ABRIR Y MAPEAR (la entrada con escritura solo en modo in-place)
+    input_fd = open(input_filepath, inplace ? O_RDWR : O_RDONLY);
+    if (input_fd < 0) {
+        ret = -errno;
+        goto out;
+    }
+    if (inplace) {
+        output_fd = dup(input_fd);
+        if (output_fd < 0) {
+            ret = -errno;
+            goto out;
+        }
+    } else {
+        output_fd = open(output_filepath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (output_fd < 0) {
+            ret = -errno;
+            goto out;
+        }
+    }
+    if (fstat(input_fd, &st) < 0) {
+        ret = -errno;
+        goto out;
+    }
+    if (st.st_size <= 0) {
+        ret = -EINVAL;
+        goto out;
+    }
+    size = st.st_size;
+
+    src = mmap(NULL, size, PROT_READ, MAP_SHARED, input_fd, 0);
+    if (src == MAP_FAILED) {
+        ret = -errno;
+        goto out;
+    }
+
+    // 3. REPARTIR EN PÁGINAS COMPLETAS (a lo sumo una página de diferencia entre partes)
+    pages = (size + page - 1) / page;
+    parts = (size_t)thread_count < pages ? (size_t)thread_count : pages;
+    fragments = calloc(parts, sizeof(*fragments));
+    if (!fragments) {
+        ret = -ENOMEM;
+        goto out;
+    }
+    first = 0;
+    for (size_t i = 0; i < parts; i++) {
+        size_t n = pages / parts + (i < pages % parts);
+        struct user_fragment *f = &fragments[i];
+
+        f->src = src;
+        f->output_fd = output_fd;
+        f->start = first * page;
+        f->end = (first + n) * page < size ? (first + n) * page : size;
+        f->key_stream = key_stream;
+        f->key_span = key_span;
+        f->key_length = key_length;
+        first += n;
+    }
+
+    // 4. CIFRAR: la parte 0 la hace este mismo hilo
+    for (size_t i = 1; i < parts; i++) {
+        fragments[i].started = pthread_create(&fragments[i].thread, NULL, user_xor_fragment, &fragments[i]) == 0;
+        // Sin hilo nuevo: esa parte se hace aquí
+        if (!fragments[i].started)
+            user_xor_fragment(&fragments[i]);
+    }
+    user_xor_fragment(&fragments[0]);
+    ret = 0;
+    for (size_t i = 0; i < parts; i++) {
+        if (i > 0 && fragments[i].started)
+            pthread_join(fragments[i].thread, NULL);
+        if (fragments[i].status < 0 && ret == 0)
+            ret = fragments[i].status;
+    }
+
+out:
+    // 5. LIBERAR
+    if (src != MAP_FAILED)
+        munmap(src, size);
+    if (output_fd >= 0)
+        close(output_fd);
+    if (input_fd >= 0)
+        close(input_fd);
+    free(fragments);
+    explicit_bzero(key_stream, key_span);
+    free(key_stream);
+    return ret;
+}
+
+#endif /* _ENCRYPT_USER_H */
@@ -0,0 +1,170 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Tracepoints de my_encrypt (kernel/encrypt.c), una por fase:
+ * abrir archivos, leer la clave, leer cada bloque, repartir y juntar el XOR
+ * de cada bloque, escribirlo y el resumen de la llamada.
+ * Todas las duraciones van en nanosegundos.
+ *
+ *   echo 1 > /sys/kernel/tracing/events/encrypt/enable
+ *   cat /sys/kernel/tracing/trace_pipe
+ */
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM encrypt
+
+#if !defined(_TRACE_ENCRYPT_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_ENCRYPT_H
+
+#include <linux/tracepoint.h>
+
+// Entrada y salida abiertas, tamaño de la entrada ya leído
+TRACE_EVENT(encrypt_open,
+
+    TP_PROTO(const char *input, size_t size, unsigned int flags, u64 ns),
+
+    TP_ARGS(input, size, flags, ns),
+
+    TP_STRUCT__entry(
+        __string(input, input)
+        __field(size_t, size)
+        __field(unsigned int, flags)
+        __field(u64, ns)
+    ),
+
+    TP_fast_assign(
+        __assign_str(input);
+        __entry->size = size;
+        __entry->flags = flags;
+        __entry->ns = ns;
+    ),
+
+    TP_printk("input=%s size=%zu flags=0x%x ns=%llu",
+              __get_str(input), __entry->size, __entry->flags, __entry->ns)
+);
+
+// Archivo de clave leído y expandido (o cargado en el tfm), o tomado de la caché
+TRACE_EVENT(encrypt_key_read,
+
+    TP_PROTO(size_t length, unsigned int alg, bool cached, u64 ns, int ret),
+
+    TP_ARGS(length, alg, cached, ns, ret),
+
+    TP_STRUCT__entry(
+        __field(size_t, length)
+        __field(unsigned int, alg)
+        __field(bool, cached)
+        __field(u64, ns)
+        __field(int, ret)
+    ),
+
+    TP_fast_assign(
+        __entry->length = length;
+        __entry->alg = alg;
+        __entry->cached = cached;
+        __entry->ns = ns;
+        __entry->ret = ret;
+    ),
+
+    TP_printk("length=%zu alg=0x%x cached=%d ns=%llu ret=%d",
+              __entry->length, __entry->alg, __entry->cached, __entry->ns, __entry->ret)
+);
+
+// Lectura y escritura de un bloque: mismo formato
+DECLARE_EVENT_CLASS(encrypt_chunk_io,
+
+    TP_PROTO(long seq, loff_t pos, size_t len, u64 ns, long ret),
+
+    TP_ARGS(seq, pos, len, ns, ret),
+
+    TP_STRUCT__entry(
+        __field(long, seq)
+        __field(loff_t, pos)
+        __field(size_t, len)
+        __field(u64, ns)
+        __field(long, ret)
+    ),
+
+    TP_fast_assign(
+        __entry->seq = seq;
+        __entry->pos = pos;
+        __entry->len = len;
+        __entry->ns = ns;
+        __entry->ret = ret;
+    ),
+
+    TP_printk("seq=%ld pos=%lld len=%zu ns=%llu ret=%ld",
+              __entry->seq, __entry->pos, __entry->len, __entry->ns, __entry->ret)
+);
+
+// kernel_read del bloque (o fijar sus páginas en modo zero-copy)
+DEFINE_EVENT(encrypt_chunk_io, encrypt_read,
+    TP_PROTO(long seq, loff_t pos, size_t len, u64 ns, long ret),
+    TP_ARGS(seq, pos, len, ns, ret)
+);
+
+// kernel_write del bloque cifrado
+DEFINE_EVENT(encrypt_chunk_io, encrypt_write,
+    TP_PROTO(long seq, loff_t pos, size_t len, u64 ns, long ret),
+    TP_ARGS(seq, pos, len, ns, ret)
+);
+
+// Desde que el lector reparte las partes de un bloque hasta que termina la última
+TRACE_EVENT(encrypt_xor,
+
+    TP_PROTO(long seq, size_t len, unsigned int parts, u64 ns),
+
+    TP_ARGS(seq, len, parts, ns),
+
+    TP_STRUCT__entry(
+        __field(long, seq)
+        __field(size_t, len)
+        __field(unsigned int, parts)
+        __field(u64, ns)
+    ),
+
+    TP_fast_assign(
+        __entry->seq = seq;
+        __entry->len = len;
+        __entry->parts = parts;
+        __entry->ns = ns;
+    ),
+
+    TP_printk("seq=%ld len=%zu parts=%u ns=%llu",
+              __entry->seq, __entry->len, __entry->parts, __entry->ns)
+);
+
+// Fin de la llamada: tiempo total y cuánto se fue en cada etapa
+TRACE_EVENT(encrypt_done,
+
+    TP_PROTO(size_t size, int threads, u64 ns, u64 read_ns, u64 xor_ns, u64 write_ns, int ret),
+
+    TP_ARGS(size, threads, ns, read_ns, xor_ns, write_ns, ret),
+
+    TP_STRUCT__entry(
+        __field(size_t, size)
+        __field(int, threads)
+        __field(u64, ns)
+        __field(u64, read_ns)
+        __field(u64, xor_ns)
+        __field(u64, write_ns)
+        __field(int, ret)
+    ),
+
+    TP_fast_assign(
+        __entry->size = size;
+        __entry->threads = threads;
+        __entry->ns = ns;
+        __entry->read_ns = read_ns;
+        __entry->xor_ns = xor_ns;
+        __entry->write_ns = write_ns;
+        __entry->ret = ret;
+    ),
+
+    TP_printk("size=%zu threads=%d ns=%llu read_ns=%llu xor_ns=%llu write_ns=%llu ret=%d",
+              __entry->size, __entry->threads, __entry->ns,
+              __entry->read_ns, __entry->xor_ns, __entry->write_ns, __entry->ret)
+);
+
+#endif /* _TRACE_ENCRYPT_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
@@ -0,0 +1,57 @@
+/* SPDX-License-Identifier: GPL-2.0 WITH Linux-syscall-note */
+/*
+ * include/uapi/linux/my_encrypt.h
+ * Constantes de la syscall my_encrypt compartidas entre el kernel y los
+ * programas de usuario.
+ */
+#ifndef _UAPI_LINUX_MY_ENCRYPT_H
+#define _UAPI_LINUX_MY_ENCRYPT_H
+
+#include <linux/types.h>
+
+/* Banderas de my_encrypt_ex (quinto argumento) */
+
+/* Cifrar el archivo de entrada sobre sí mismo; la ruta de salida se ignora */
+#define MY_ENCRYPT_F_INPLACE   0x00000001
+/* Leer directo de la page cache de la entrada (sin copiar a un buffer primero) */
+#define MY_ENCRYPT_F_ZEROCOPY  0x00000002
+
+
+/*
+ * Algoritmo (bits 8-11 de las banderas). Sin estos bits se usa el XOR con
+ * clave repetida de siempre. Con un cifrado real el archivo de clave es la
+ * clave seguida de un IV/nonce de 16 bytes:
+ *   AES-CTR:  16, 24 o 32 bytes de clave + 16 de IV (AES-128/192/256)
+ *   ChaCha20: 32 bytes de clave + 16 de IV (contador de 32 bits LE + nonce de 96 bits)
+ * CTR y ChaCha20 son cifrados de flujo: cifrar otra vez con la misma clave
+ * descifra. Nunca reutilizar el mismo IV con la misma clave para otro archivo.
+ */
+#define MY_ENCRYPT_ALG_MASK      0x00000f00
+#define MY_ENCRYPT_ALG_XOR       0x00000000
+#define MY_ENCRYPT_ALG_AES_CTR   0x00000100
+#define MY_ENCRYPT_ALG_CHACHA20  0x00000200
+
+/* Largo del IV/nonce al final del archivo de clave */
+#define MY_ENCRYPT_IV_SIZE     16
+
+#define MY_ENCRYPT_F_ALL       (MY_ENCRYPT_F_INPLACE | MY_ENCRYPT_F_ZEROCOPY | MY_ENCRYPT_ALG_MASK)
+
+/* my_encrypt_batch: un archivo del lote */
+struct my_encrypt_batch_entry {
+	__u64 input;   /* const char * con la ruta de entrada */
+	__u64 output;  /* const char * con la ruta de salida (se ignora con MY_ENCRYPT_F_INPLACE) */
+	__s32 status;  /* salida: 0 si se cifró bien, -errno si falló */
+	__u32 __pad;
+};
+
+/* Máximo de archivos por llamada a my_encrypt_batch */
+#define MY_ENCRYPT_BATCH_MAX   65536
+
+/* my_encrypt_submit: lo que devuelve read() sobre el descriptor del trabajo */
+struct my_encrypt_completion {
+	__s32 status;     /* 0 si se cifró bien, -errno si falló */
+	__u32 __pad;
+	__u64 elapsed_ns; /* Desde el envío hasta el final del trabajo */
+};
+
+#endif /* _UAPI_LINUX_MY_ENCRYPT_H */
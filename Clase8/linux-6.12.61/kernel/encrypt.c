@@ -3,217 +3,1311 @@
 #include <linux/fs.h>
 #include <linux/uaccess.h>
 #include <linux/slab.h>
-#include <linux/kthread.h>
 #include <linux/delay.h>
+#include <linux/wait.h>
+#include <linux/atomic.h>
+#include <linux/moduleparam.h>
+#include <linux/workqueue.h>
+#include <linux/cpumask.h>
+#include <linux/nodemask.h>
+#include <linux/topology.h>
+#include <linux/cache.h>
+#include <linux/init.h>
+#include <linux/pagemap.h>
+#include <linux/highmem.h>
+#include <linux/fadvise.h>
+#include <linux/kref.h>
+#include <linux/anon_inodes.h>
+#include <linux/poll.h>
+#include <linux/ktime.h>
+#include <linux/list.h>
+#include <linux/spinlock.h>
+#include <linux/mutex.h>
+#include <linux/namei.h>
+#include <linux/iversion.h>
+#include <linux/string.h>
+#include <linux/sched.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file.h>
+#include <linux/scatterlist.h>
+#include <linux/unaligned.h>
+#include <crypto/skcipher.h>
+#include <crypto/aes.h>
+#include <crypto/chacha.h>
+#include <uapi/linux/my_encrypt.h>
+
+#include "encrypt_xor.h"
+
+#define CREATE_TRACE_POINTS
+#include <trace/events/encrypt.h>
+
+// --- PARÁMETROS DEL PIPELINE ---
+// En lugar de cargar TODO el archivo en RAM, lo procesamos por bloques (chunks)
+// que circulan por un anillo. La memoria máxima usada es ring_chunks * chunk_kb,
+// sin importar el tamaño del archivo.
+// Se pueden ajustar en el arranque (encrypt.chunk_kb=...) o en
+// /sys/module/encrypt/parameters/ sin recompilar.
+static unsigned int encrypt_chunk_kb = 1024;
+module_param_named(chunk_kb, encrypt_chunk_kb, uint, 0644);
+MODULE_PARM_DESC(chunk_kb, "Tamaño de cada bloque del pipeline en KiB");
+
+static unsigned int encrypt_ring_chunks = 4;
+module_param_named(ring_chunks, encrypt_ring_chunks, uint, 0644);
+MODULE_PARM_DESC(ring_chunks, "Número de bloques en el anillo (memoria máxima = ring_chunks * chunk_kb)");
+
+// kmalloc no puede entregar bloques gigantes, limitamos el tamaño del chunk.
+#define ENCRYPT_MAX_CHUNK_KB 4096
+
+// Modo depuración: en lugar de imprimir dos líneas por hilo, contamos los
+// fragmentos procesados y mostramos un resumen por llamada solo si se activa.
+static bool encrypt_debug;
+module_param_named(debug, encrypt_debug, bool, 0644);
+MODULE_PARM_DESC(debug, "Cuenta los fragmentos procesados e imprime un resumen por llamada");
+
+static atomic64_t encrypt_fragments_done = ATOMIC64_INIT(0);
+
+// --- POOL DE TRABAJADORES ---
+// Los hilos ya no se crean en cada llamada: se crean una sola vez al arrancar
+// el kernel y se reutilizan.
+// - encrypt_wq: un trabajador por CPU en línea para el XOR (trabajo de CPU).
+// - encrypt_io_wq: trabajadores para el escritor (se bloquea en disco).
+// - encrypt_job_wq: un trabajo por archivo de un lote (my_encrypt_batch).
+static struct workqueue_struct *encrypt_wq;
+static struct workqueue_struct *encrypt_io_wq;
+static struct workqueue_struct *encrypt_job_wq;
+
+// Tope de partes por bloque: más partes que CPUs no aceleran nada (y chunk_parts
+// ya limita a una página por parte). Sin tope, un thread_count enorme pediría
+// reservas gigantes para los trabajos de cada ranura.
+#define ENCRYPT_THREADS_PER_CPU 4
+
+static int encrypt_clamp_threads(int thread_count)
+{
+    return min_t(int, thread_count, num_online_cpus() * ENCRYPT_THREADS_PER_CPU);
+}
+
+// Cuántos archivos de un lote se cifran a la vez. Cada uno usa su propio
+// anillo (ring_chunks * chunk_kb de RAM), pero todos comparten el pool XOR.
+static unsigned int encrypt_batch_jobs = 4;
+module_param_named(batch_jobs, encrypt_batch_jobs, uint, 0444);
+MODULE_PARM_DESC(batch_jobs, "Archivos de un lote que se cifran en paralelo (solo al arrancar)");
+
+// Qué tan "igual" está el archivo de una clave: mtime solo no alcanza, porque
+// se puede reescribir dentro del mismo tick o devolverle la fecha con touch -d.
+// ctime no se puede fijar desde espacio de usuario e i_version, donde el sistema
+// de archivos lo lleva, cambia con cada escritura aunque el reloj no avance.
+struct encrypt_key_stamp {
+    struct timespec64 mtime;
+    struct timespec64 ctime;
+    u64 version;
+};
+
+// La clave ya leída y expandida. Con kref se comparte entre todos los
+// archivos de un lote y se libera cuando el último termina.
+struct encrypt_key {
+    struct kref ref;
+    unsigned char *stream;        // La clave repetida, lista para el XOR por palabras
+    size_t span;                  // Largo del flujo (múltiplo de length)
+    size_t length;                // Largo real de la clave
+    // Con un cifrado real (MY_ENCRYPT_ALG_*) en lugar del XOR:
+    unsigned int alg;             // MY_ENCRYPT_ALG_*
+    struct crypto_skcipher *tfm;  // "ctr(aes)" o "chacha20", con la clave ya cargada
+    u8 iv[MY_ENCRYPT_IV_SIZE];    // IV del byte 0 del archivo
+    // Caché de claves: de qué archivo salió (ver encrypt_key_matches)
+    struct list_head lru;         // En encrypt_key_cache, la más reciente primero
+    dev_t dev;
+    unsigned long ino;
+    struct encrypt_key_stamp stamp;
+    loff_t size;
+};
 
 // Estructura que define "un pedazo" de trabajo para un hilo.
 // Contiene punteros a los datos, la clave y dónde empezar/terminar.
 typedef struct {
-    unsigned char *buffer;        // Puntero a los datos completos del archivo en RAM
-    size_t data_size;             // Tamaño total
-    unsigned char *encryption_key;// Puntero a la clave en RAM
+    unsigned char *buffer;        // Puntero a los datos del bloque en RAM
+    size_t data_size;             // Tamaño del bloque
+    unsigned char *key_stream;    // Clave ya repetida (ver encrypt_xor.h)
+    size_t key_span;              // Largo del flujo de clave (múltiplo de key_length)
     size_t key_length;            // Largo de la clave
+    loff_t file_offset;           // Posición del bloque dentro del archivo (para alinear la clave)
+    struct folio **folios;        // Modo zero-copy: páginas de la entrada, una por página del bloque
     size_t start_idx;             // Byte donde este hilo empieza a trabajar
     size_t end_idx;               // Byte donde este hilo termina
 } DataFragment;
 
-// Estructura para coordinar el hilo.
-struct task_params {
-    DataFragment data_fragment;   // Los datos que el hilo va a procesar
-    struct completion completed_event; // Una "señal" para avisar cuando termine
+// Números de una llamada a handle_file_encryption, para /proc/my_encrypt_jobs.
+// Los tiempos por etapa se suman bloque a bloque: como las etapas se traslapan,
+// la suma más grande dice qué limita la llamada (disco o CPU).
+struct encrypt_job_stats {
+    struct list_head node;        // En encrypt_jobs_active mientras corre
+    pid_t pid;
+    char comm[TASK_COMM_LEN];
+    char name[32];                // Archivo de entrada (sin la ruta)
+    size_t size;
+    int threads;
+    unsigned int flags;
+    u64 start_ns, end_ns;         // ktime_get_ns; end_ns = 0 mientras corre
+    u64 bytes_done;               // Bytes ya escritos (solo lo toca el escritor)
+    u64 read_ns;                  // Dentro de kernel_read (o fijando páginas), solo el lector
+    u64 write_ns;                 // Dentro de kernel_write, solo el escritor
+    atomic64_t xor_ns;            // De repartir un bloque a que termina su última parte
+    int result;
 };
 
+// Quién pidió el cifrado. Se anota en la syscall: en un lote o en modo
+// asíncrono el trabajo lo hace un kworker, que no es quien lo pidió.
+struct encrypt_owner {
+    pid_t pid;
+    char comm[TASK_COMM_LEN];
+};
+
+static void encrypt_owner_current(struct encrypt_owner *owner)
+{
+    owner->pid = task_pid_nr(current);
+    get_task_comm(owner->comm, current);
+}
+
+// Trabajos en curso (viven en la pila de su llamada) y los últimos terminados (copias)
+#define ENCRYPT_RECENT_JOBS 32
+static LIST_HEAD(encrypt_jobs_active);
+static struct encrypt_job_stats encrypt_jobs_recent[ENCRYPT_RECENT_JOBS];
+static unsigned int encrypt_jobs_recent_next;
+static DEFINE_SPINLOCK(encrypt_jobs_lock);
+
+// Estados por los que pasa cada bloque del anillo:
+// LIBRE -> LEÍDO (listo para XOR) -> CIFRADO (listo para escribir) -> LIBRE
+enum chunk_state {
+    CHUNK_FREE,
+    CHUNK_READY,
+    CHUNK_DONE,
+};
+
+// Un bloque del anillo.
+// Alineado a línea de caché: 'pending' lo escriben varios CPUs a la vez y no
+// debe compartir línea con el bloque vecino (false sharing).
+struct encrypt_chunk {
+    unsigned char *data;          // Buffer de chunk_size bytes
+    size_t len;                   // Bytes válidos en el buffer
+    loff_t pos;                   // Posición del bloque en el archivo
+    long seq;                     // Número de bloque que contiene actualmente
+    int state;                    // enum chunk_state
+    atomic_t pending;             // Hilos que aún no terminan su parte de este bloque
+    u64 queued_ns;                // Cuándo se repartieron sus partes (para encrypt_xor)
+    unsigned int parts;           // En cuántas partes se reparte (<= thread_count, ver chunk_parts)
+    struct folio **folios;        // Modo zero-copy: páginas de la page cache que cubren el bloque
+    unsigned int nr_folios;       // Cuántas hay retenidas (se sueltan al terminar el XOR)
+} ____cacheline_aligned_in_smp;
+
+// Estado compartido por el lector (hilo de la syscall), los hilos XOR y el escritor.
+struct encrypt_pipeline {
+    struct encrypt_chunk *ring;   // El anillo de bloques
+    unsigned int nr_slots;        // Cuántos bloques tiene el anillo
+    size_t chunk_size;            // Tamaño de cada bloque
+    long nr_chunks;               // Cuántos bloques tiene el archivo completo
+    unsigned char *key_stream;    // Clave expandida, compartida por todos los trabajos
+    size_t key_span;
+    size_t key_length;
+    int thread_count;
+    unsigned int flags;           // MY_ENCRYPT_F_*
+    struct encrypt_key *key;      // Para el modo cifrado: tfm e IV
+    struct file *output_file;
+    struct task_params *tasks;    // nr_slots * thread_count trabajos XOR
+    int *cpus;                    // CPU fija para cada parte (index), ordenadas por cercanía NUMA
+    struct work_struct write_work;// Trabajo del escritor
+    wait_queue_head_t wq;         // Aquí duermen las etapas esperando un bloque
+    int error;                    // Primer error encontrado (0 = todo bien)
+    // Bloques en el pool que aún no terminan (+1 del lector). En su propia línea de caché.
+    atomic_t inflight ____cacheline_aligned_in_smp;
+    struct completion idle;       // Se completa cuando inflight llega a 0
+    struct completion writer_done;// Se completa cuando el escritor termina
+    struct encrypt_job_stats stats;
+};
+
+// Un trabajo XOR: una parte (index) de un bloque (chunk).
+// Cada uno ocupa su propia línea de caché: el pool los toca desde CPUs
+// distintas y no queremos que se invaliden entre sí.
+struct task_params {
+    struct work_struct work;      // Lo que se encola en el pool
+    struct encrypt_pipeline *pipe;// El pipeline al que pertenece
+    struct encrypt_chunk *chunk;  // El bloque a cifrar
+    int index;                    // Qué parte del bloque le toca
+    // Modo cifrado: una petición por trabajo, reservada una vez y reutilizada
+    struct skcipher_request *req;
+    struct scatterlist *src_sg;   // Zero-copy: una entrada por página de la entrada
+    struct scatterlist dst_sg;    // La parte del buffer del bloque
+    u8 iv[MY_ENCRYPT_IV_SIZE];    // IV de esta parte (debe vivir hasta que termine la petición)
+} ____cacheline_aligned_in_smp;
+
+// Marca el pipeline como fallido y despierta a todos para que salgan.
+static void pipeline_fail(struct encrypt_pipeline *pipe, int err)
+{
+    cmpxchg(&pipe->error, 0, err);
+    wake_up_all(&pipe->wq);
+}
+
+// ¿El bloque 'seq' está en su ranura y en el estado esperado?
+static bool chunk_has(struct encrypt_chunk *chunk, long seq, int state)
+{
+    return smp_load_acquire(&chunk->state) == state && READ_ONCE(chunk->seq) == seq;
+}
+
+// Cambia el estado de un bloque y avisa a las demás etapas.
+static void chunk_set_state(struct encrypt_pipeline *pipe, struct encrypt_chunk *chunk, int state)
+{
+    smp_store_release(&chunk->state, state);
+    wake_up_all(&pipe->wq);
+}
+
+// En cuántas partes se reparte un bloque: nunca menos de una página por parte.
+static unsigned int chunk_parts(struct encrypt_pipeline *pipe, size_t len)
+{
+    return min_t(unsigned int, pipe->thread_count, DIV_ROUND_UP(len, PAGE_SIZE));
+}
+
+// Límites de la parte 'index' de un bloque de 'len' bytes repartido en 'parts':
+// siempre en frontera de página y con a lo sumo una página de diferencia entre partes.
+// (Antes el último hilo se llevaba todos los bytes sobrantes.)
+static void fragment_bounds(size_t len, unsigned int parts, unsigned int index, size_t *start, size_t *end)
+{
+    size_t pages = DIV_ROUND_UP(len, PAGE_SIZE);
+
+    *start = (pages * index / parts) << PAGE_SHIFT;
+    *end = min_t(size_t, (pages * (index + 1) / parts) << PAGE_SHIFT, len);
+}
+
+// Suelta una referencia de 'inflight'; el último avisa al lector.
+static void pipeline_put(struct encrypt_pipeline *pipe)
+{
+    if (atomic_dec_and_test(&pipe->inflight))
+        complete(&pipe->idle);
+}
+
+// Suelta las páginas de la page cache que retenía un bloque (modo zero-copy).
+static void chunk_release_folios(struct encrypt_chunk *chunk)
+{
+    unsigned int i;
+
+    for (i = 0; i < chunk->nr_folios; i++)
+        folio_put(chunk->folios[i]);
+    chunk->nr_folios = 0;
+}
+
+// Modo zero-copy: el XOR lee directo de las páginas de la entrada y deja el
+// resultado en el buffer del bloque. Copia y cifrado son UNA sola pasada.
+static void xor_fragment_from_folios(DataFragment *fragment, size_t key_pos)
+{
+    size_t off = fragment->start_idx, n;
+    loff_t pos;
+    struct folio *folio;
+    unsigned char *src;
+
+    while (off < fragment->end_idx) {
+        // Avanzamos página por página: kmap_local_folio mapea de a una
+        pos = fragment->file_offset + off;
+        folio = fragment->folios[off >> PAGE_SHIFT];
+        n = min_t(size_t, PAGE_SIZE - offset_in_page(pos), fragment->end_idx - off);
+
+        src = kmap_local_folio(folio, offset_in_folio(folio, pos));
+        key_pos = xor_stream_copy(fragment->buffer + off, src, n,
+                                  fragment->key_stream, fragment->key_span, key_pos);
+        kunmap_local(src);
+        off += n;
+    }
+}
+
+// Aplica el XOR a la sección [start_idx, end_idx) de un bloque.
+static void xor_fragment(DataFragment *fragment)
+{
+    size_t key_pos;
+
+    // OPERACIÓN XOR (^=):
+    // Toma el byte del archivo y le aplica XOR con un byte de la clave.
+    // Usamos la posición ABSOLUTA en el archivo para que el resultado sea el mismo
+    // que si el archivo completo estuviera en un solo buffer.
+    // El módulo se calcula UNA vez por fragmento; xor_stream avanza de 8 en 8 bytes
+    // sobre el flujo de clave y vuelve a 0 al final, sin dividir por cada byte.
+    key_pos = (fragment->file_offset + fragment->start_idx) % fragment->key_length;
+    if (fragment->folios) {
+        xor_fragment_from_folios(fragment, key_pos);
+        return;
+    }
+    xor_stream(fragment->buffer + fragment->start_idx, fragment->end_idx - fragment->start_idx,
+               fragment->key_stream, fragment->key_span, key_pos);
+}
+
+// IV de la posición 'pos' del archivo (múltiplo del bloque del algoritmo:
+// las partes siempre empiezan en frontera de página).
+static void cipher_iv_at(const struct encrypt_key *key, loff_t pos, u8 *iv)
+{
+    u64 hi, lo, add;
+
+    memcpy(iv, key->iv, MY_ENCRYPT_IV_SIZE);
+    if (key->alg == MY_ENCRYPT_ALG_CHACHA20) {
+        // chacha20: los primeros 4 bytes son el contador de bloques de 64 bytes (little endian)
+        put_unaligned_le32(get_unaligned_le32(iv) + (u32)(pos / CHACHA_BLOCK_SIZE), iv);
+        return;
+    }
+    // ctr(aes): el IV entero es un contador de 128 bits big endian, +1 por bloque de 16 bytes
+    hi = get_unaligned_be64(iv);
+    lo = get_unaligned_be64(iv + 8);
+    add = pos / AES_BLOCK_SIZE;
+    if (lo + add < lo)
+        hi++;
+    put_unaligned_be64(hi, iv);
+    put_unaligned_be64(lo + add, iv + 8);
+}
+
+// Fin de la parte de un bloque (XOR o cifrado): el último en terminar pasa el bloque al escritor.
+static void fragment_finish(struct task_params *params)
+{
+    struct encrypt_pipeline *pipe = params->pipe;
+    struct encrypt_chunk *chunk = params->chunk;
+
+    if (READ_ONCE(encrypt_debug))
+        atomic64_inc(&encrypt_fragments_done);
+
+    // En modo zero-copy ya nadie necesita las páginas de la entrada: se sueltan.
+    // Solo el último toca el pipeline: así 'inflight' se escribe una vez por bloque,
+    // no una vez por parte.
+    if (atomic_dec_and_test(&chunk->pending)) {
+        u64 ns = ktime_get_ns() - chunk->queued_ns;
+
+        atomic64_add(ns, &pipe->stats.xor_ns);
+        trace_encrypt_xor(chunk->seq, chunk->len, chunk->parts, ns);
+        chunk_release_folios(chunk);
+        chunk_set_state(pipe, chunk, CHUNK_DONE);
+        pipeline_put(pipe);
+    }
+}
+
+// Una implementación asíncrona del cifrado (un acelerador) terminó la petición
+static void cipher_fragment_done(void *data, int err)
+{
+    struct task_params *params = data;
+
+    // Salió de la cola de espera (backlog) del driver: todavía no terminó
+    if (err == -EINPROGRESS)
+        return;
+    if (err)
+        pipeline_fail(params->pipe, err);
+    fragment_finish(params);
+}
+
+/*
+ * Modo cifrado: envía la parte [start, end) del bloque como una petición
+ * skcipher. El kernel elige la implementación más rápida registrada para
+ * "ctr(aes)" o "chacha20" (AES-NI, AVX2, ...). Devuelve 0 si ya terminó,
+ * -EINPROGRESS/-EBUSY si la terminará cipher_fragment_done, o -errno.
+ */
+static int cipher_fragment(struct task_params *params, size_t start, size_t end)
+{
+    struct encrypt_pipeline *pipe = params->pipe;
+    struct encrypt_chunk *chunk = params->chunk;
+    struct scatterlist *src = &params->dst_sg;
+    size_t off, n;
+    int i = 0;
+
+    cipher_iv_at(pipe->key, chunk->pos + start, params->iv);
+    sg_init_one(&params->dst_sg, chunk->data + start, end - start);
+
+    // Zero-copy: la petición lee directo de las páginas de la entrada
+    if (chunk->nr_folios) {
+        src = params->src_sg;
+        sg_init_table(src, DIV_ROUND_UP(end - start, PAGE_SIZE));
+        for (off = start; off < end; off += n, i++) {
+            loff_t pos = chunk->pos + off;
+            struct folio *folio = chunk->folios[off >> PAGE_SHIFT];
+
+            n = min_t(size_t, PAGE_SIZE, end - off);
+            sg_set_page(&src[i], folio_file_page(folio, pos >> PAGE_SHIFT), n, 0);
+        }
+    }
+
+    skcipher_request_set_callback(params->req, CRYPTO_TFM_REQ_MAY_BACKLOG | CRYPTO_TFM_REQ_MAY_SLEEP,
+                                  cipher_fragment_done, params);
+    skcipher_request_set_crypt(params->req, src, &params->dst_sg, end - start, params->iv);
+    return crypto_skcipher_encrypt(params->req);
+}
+
 // --- EL NÚCLEO DE LA OPERACIÓN ---
-// Esta función es la que ejecuta cada hilo individualmente.
-int perform_xor_operation(void *arg) {
-    struct task_params *params = (struct task_params *)arg;
-    DataFragment *fragment = &params->data_fragment;
-    size_t i;
-
-    printk(KERN_INFO "Thread iniciado: start_idx=%zu, end_idx=%zu\n", fragment->start_idx, fragment->end_idx);
-
-    // Bucle principal: Recorre SOLO la sección del archivo asignada a este hilo
-    for (i = fragment->start_idx; i < fragment->end_idx; i++) {
-        // OPERACIÓN XOR (^=):
-        // Toma el byte del archivo y le aplica XOR con un byte de la clave.
-        // El operador % (módulo) hace que si la clave es corta, se repita en bucle.
-        fragment->buffer[i] ^= fragment->encryption_key[i % fragment->key_length];
-    }
-
-    printk(KERN_INFO "Thread finalizado: start_idx=%zu, end_idx=%zu\n", fragment->start_idx, fragment->end_idx);
-    
-    // Avisa al hilo principal que este trabajador ha terminado
-    complete(&params->completed_event);
+// Esta función la ejecuta un trabajador del pool por cada parte de cada bloque.
+static void perform_xor_operation(struct work_struct *work) {
+    struct task_params *params = container_of(work, struct task_params, work);
+    struct encrypt_pipeline *pipe = params->pipe;
+    struct encrypt_chunk *chunk = params->chunk;
+    DataFragment fragment;
+    int ret;
+
+    // Si otra etapa ya falló no vale la pena cifrar, pero sí hay que soltar la referencia
+    if (!READ_ONCE(pipe->error)) {
+        // Calculamos la parte del bloque que le toca a este trabajo
+        fragment_bounds(chunk->len, chunk->parts, params->index, &fragment.start_idx, &fragment.end_idx);
+
+        if (params->req) {
+            // Si el driver es asíncrono este trabajador queda libre; el callback cierra la parte
+            ret = cipher_fragment(params, fragment.start_idx, fragment.end_idx);
+            if (ret == -EINPROGRESS || ret == -EBUSY)
+                return;
+            if (ret)
+                pipeline_fail(pipe, ret);
+            fragment_finish(params);
+            return;
+        }
+
+        fragment.buffer = chunk->data;
+        fragment.data_size = chunk->len;
+        fragment.key_stream = pipe->key_stream;
+        fragment.key_span = pipe->key_span;
+        fragment.key_length = pipe->key_length;
+        fragment.file_offset = chunk->pos;
+        fragment.folios = chunk->nr_folios ? chunk->folios : NULL;
+
+        xor_fragment(&fragment);
+    }
+
+    fragment_finish(params);
+}
+
+// Etapa de escritura: toma los bloques ya cifrados en orden y los guarda en disco.
+// Corre en un trabajador aparte para que escribir el bloque N-1 se traslape con
+// el XOR del bloque N y la lectura del bloque N+1.
+static void write_chunks(struct work_struct *work) {
+    struct encrypt_pipeline *pipe = container_of(work, struct encrypt_pipeline, write_work);
+    long seq;
+    ssize_t written;
+    u64 t;
+
+    for (seq = 0; seq < pipe->nr_chunks; seq++) {
+        struct encrypt_chunk *chunk = &pipe->ring[seq % pipe->nr_slots];
+        loff_t out_offset;
+
+        wait_event(pipe->wq, chunk_has(chunk, seq, CHUNK_DONE) || READ_ONCE(pipe->error));
+        if (READ_ONCE(pipe->error))
+            break;
+
+        out_offset = chunk->pos;
+
+        t = ktime_get_ns();
+        written = kernel_write(pipe->output_file, chunk->data, chunk->len, &out_offset);
+        t = ktime_get_ns() - t;
+        trace_encrypt_write(seq, chunk->pos, chunk->len, t, written);
+        WRITE_ONCE(pipe->stats.write_ns, pipe->stats.write_ns + t);
+        if (written != chunk->len) {
+            printk(KERN_ERR "Error al escribir en salida: %zd\n", written);
+            pipeline_fail(pipe, written < 0 ? written : -EIO);
+            break;
+        }
+
+        WRITE_ONCE(pipe->stats.bytes_done, chunk->pos + chunk->len);
+
+        // El bloque queda libre para que el lector lo vuelva a llenar
+        chunk_set_state(pipe, chunk, CHUNK_FREE);
+    }
+
+    complete(&pipe->writer_done);
+}
+
+// Lee exactamente 'len' bytes (kernel_read puede devolver menos de lo pedido).
+static ssize_t read_full(struct file *file, unsigned char *buf, size_t len, loff_t *pos)
+{
+    size_t done = 0;
+    ssize_t ret;
+
+    while (done < len) {
+        ret = kernel_read(file, buf + done, len - done, pos);
+        if (ret < 0)
+            return ret;
+        if (ret == 0)
+            return -EIO; // El archivo se hizo más pequeño mientras lo leíamos
+        done += ret;
+    }
+    return done;
+}
+
+// Modo zero-copy: en lugar de copiar el bloque con kernel_read, retenemos las
+// páginas de la page cache que lo cubren. Los trabajos XOR leen de ahí.
+static int pin_chunk_folios(struct encrypt_pipeline *pipe, struct encrypt_chunk *chunk, struct file *input_file)
+{
+    pgoff_t index = chunk->pos >> PAGE_SHIFT;
+    unsigned int i, nr = DIV_ROUND_UP(chunk->len, PAGE_SIZE);
+    struct folio *folio;
+
+    // Pedimos readahead de la ventana que viene, así la lectura del disco
+    // se adelanta mientras el pool cifra este bloque
+    vfs_fadvise(input_file, chunk->pos + pipe->chunk_size,
+                (loff_t)pipe->chunk_size * pipe->nr_slots, POSIX_FADV_WILLNEED);
+
+    for (i = 0; i < nr; i++) {
+        // read_mapping_folio devuelve la página ya leída (uptodate) con una referencia
+        folio = read_mapping_folio(input_file->f_mapping, index + i, input_file);
+        if (IS_ERR(folio)) {
+            chunk_release_folios(chunk);
+            return PTR_ERR(folio);
+        }
+        chunk->folios[i] = folio;
+        chunk->nr_folios = i + 1;
+    }
     return 0;
 }
 
-// Función principal que prepara todo antes de lanzar los hilos
-int handle_file_encryption(const char *input_filepath, const char *output_filepath, const char *key_filepath, int thread_count) {
-    struct file *input_file, *output_file, *key_file; // Punteros a los archivos en el kernel
-    loff_t in_offset = 0, out_offset = 0, key_offset = 0; // Posición de lectura/escritura (cursor)
-    unsigned char *encryption_key, *file_buffer; // Buffers para guardar datos en RAM
-    size_t file_size, key_length;
-    
-    // Arrays para gestionar los múltiples hilos
-    struct task_params *task_list; 
-    struct task_struct **thread_list;
-    DataFragment *fragment_list;
-    
-    size_t fragment_size, extra_bytes;
-    int i, ret_val = 0;
+// ¿Se pueden leer las páginas de la entrada directo de la page cache?
+// read_mapping_folio necesita un archivo normal cuyo sistema de archivos tenga
+// read_folio (procfs y otros pseudo sistemas de archivos no lo tienen).
+static bool encrypt_can_zerocopy(struct file *input_file)
+{
+    return S_ISREG(file_inode(input_file)->i_mode) && input_file->f_mapping &&
+           input_file->f_mapping->a_ops && input_file->f_mapping->a_ops->read_folio;
+}
 
-    printk(KERN_INFO "Intentando abrir los archivos\n");
+// Elige una CPU fija para cada parte: primero las del nodo NUMA del que llama
+// (donde se reservaron los buffers), luego las de los nodos más cercanos.
+// Si hay más partes que CPUs, se repite la lista.
+static void pick_cpus(int *cpus, int count)
+{
+    int local = numa_node_id(), node, best, cpu, n = 0, i;
+    nodemask_t visited = NODE_MASK_NONE;
 
-    // 1. ABRIR ARCHIVOS
-    // filp_open es como fopen pero en espacio de kernel.
-    input_file = filp_open(input_filepath, O_RDONLY, 0);
-    // Para salida usamos O_CREAT (crear si no existe) y O_TRUNC (borrar contenido previo)
-    output_file = filp_open(output_filepath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
-    key_file = filp_open(key_filepath, O_RDONLY, 0);
+    while (n < count) {
+        // El nodo no visitado más cercano (el propio nodo tiene la distancia menor)
+        best = NUMA_NO_NODE;
+        for_each_online_node(node) {
+            if (node_isset(node, visited))
+                continue;
+            if (best == NUMA_NO_NODE || node_distance(local, node) < node_distance(local, best))
+                best = node;
+        }
+        if (best == NUMA_NO_NODE)
+            break;
+        node_set(best, visited);
 
-    // Verificación de errores al abrir archivos (IS_ERR verifica punteros inválidos)
-    if (IS_ERR(input_file)) {
-        ret_val = PTR_ERR(input_file);
-        printk(KERN_ERR "Error al abrir el archivo de entrada: %d\n", ret_val);
-        goto exit; // Salto al final para limpiar
+        for_each_cpu_and(cpu, cpumask_of_node(best), cpu_online_mask) {
+            if (n == count)
+                break;
+            cpus[n++] = cpu;
+        }
     }
-    // ... (chequeos similares para output y key_file omitidos por brevedad, son iguales) ...
 
-    if (IS_ERR(output_file)) {
-        ret_val = PTR_ERR(output_file);
-        goto close_input_file;
+    if (n == 0)
+        cpus[n++] = raw_smp_processor_id();
+    for (i = 0; n < count; n++, i++)
+        cpus[n] = cpus[i];
+}
+
+// Etapa de lectura: la ejecuta el hilo de la syscall.
+// Llena cada ranura libre del anillo con el siguiente bloque del archivo
+// y reparte sus partes entre los trabajadores del pool.
+static void read_chunks(struct encrypt_pipeline *pipe, struct file *input_file, size_t file_size)
+{
+    struct task_params *tasks;
+    long seq;
+    ssize_t ret;
+    u64 t;
+    int i;
+
+    for (seq = 0; seq < pipe->nr_chunks; seq++) {
+        struct encrypt_chunk *chunk = &pipe->ring[seq % pipe->nr_slots];
+        loff_t in_offset = (loff_t)seq * pipe->chunk_size;
+
+        // Esperamos a que el escritor libere la ranura
+        wait_event(pipe->wq, smp_load_acquire(&chunk->state) == CHUNK_FREE || READ_ONCE(pipe->error));
+        if (READ_ONCE(pipe->error))
+            return;
+
+        chunk->pos = in_offset;
+        chunk->len = min_t(size_t, pipe->chunk_size, file_size - in_offset);
+        t = ktime_get_ns();
+        if (pipe->flags & MY_ENCRYPT_F_ZEROCOPY)
+            ret = pin_chunk_folios(pipe, chunk, input_file);
+        else
+            ret = read_full(input_file, chunk->data, chunk->len, &in_offset);
+        t = ktime_get_ns() - t;
+        trace_encrypt_read(seq, chunk->pos, chunk->len, t, ret);
+        WRITE_ONCE(pipe->stats.read_ns, pipe->stats.read_ns + t);
+        if (ret < 0) {
+            printk(KERN_ERR "Error al leer la entrada: %zd\n", ret);
+            pipeline_fail(pipe, ret);
+            return;
+        }
+
+        WRITE_ONCE(chunk->seq, seq);
+        chunk->parts = chunk_parts(pipe, chunk->len);
+        atomic_set(&chunk->pending, chunk->parts);
+        atomic_inc(&pipe->inflight);
+        chunk_set_state(pipe, chunk, CHUNK_READY);
+
+        // Cada parte va siempre a la misma CPU: la ranura y su buffer se
+        // reutilizan, así esa CPU vuelve a tocar memoria que ya conoce
+        tasks = &pipe->tasks[(seq % pipe->nr_slots) * pipe->thread_count];
+        chunk->queued_ns = ktime_get_ns();
+        for (i = 0; i < chunk->parts; i++) {
+            tasks[i].chunk = chunk;
+            queue_work_on(pipe->cpus[i], encrypt_wq, &tasks[i].work);
+        }
     }
+}
+
+static void encrypt_key_release(struct kref *ref)
+{
+    struct encrypt_key *key = container_of(ref, struct encrypt_key, ref);
+
+    // kfree_sensitive borra la clave de la RAM antes de liberarla
+    kfree_sensitive(key->stream);
+    if (key->tfm)
+        crypto_free_skcipher(key->tfm); // También borra la clave cargada en el tfm
+    kfree_sensitive(key);
+}
+
+static void encrypt_key_put(struct encrypt_key *key)
+{
+    kref_put(&key->ref, encrypt_key_release);
+}
+
+// --- CACHÉ DE CLAVES ---
+// Los trabajos reutilizan unas pocas claves en millones de archivos pequeños.
+// En vez de abrir, leer y expandir el archivo de la clave en cada llamada,
+// guardamos las últimas claves ya expandidas (o ya cargadas en su tfm).
+// Cada una se identifica por dispositivo, inodo, tamaño y la "estampa" del
+// archivo (mtime, ctime, i_version): si el archivo cambia ya no coincide, y la
+// entrada vieja sale por LRU.
+// La caché tiene su propia referencia: al sacar una entrada, la clave se borra
+// de la RAM (kfree_sensitive) en cuanto el último trabajo que la usa termina.
+static unsigned int encrypt_key_cache_size = 16;
+module_param_named(key_cache, encrypt_key_cache_size, uint, 0644);
+MODULE_PARM_DESC(key_cache, "Claves expandidas que se guardan entre llamadas (0 = sin caché)");
+
+static LIST_HEAD(encrypt_key_cache);
+static unsigned int encrypt_key_cache_count;
+static u64 encrypt_key_cache_hits, encrypt_key_cache_misses, encrypt_key_cache_evictions;
+static DEFINE_MUTEX(encrypt_key_cache_lock);
+
+static void encrypt_key_stamp_get(struct inode *inode, struct encrypt_key_stamp *stamp)
+{
+    stamp->mtime = inode_get_mtime(inode);
+    stamp->ctime = inode_get_ctime(inode);
+    // Marca i_version como consultado: la próxima escritura lo incrementa
+    stamp->version = inode_query_iversion(inode);
+}
+
+static bool encrypt_key_stamp_equal(const struct encrypt_key_stamp *a, const struct encrypt_key_stamp *b)
+{
+    return timespec64_equal(&a->mtime, &b->mtime) && timespec64_equal(&a->ctime, &b->ctime) &&
+           a->version == b->version;
+}
+
+// ¿La clave salió de este archivo, tal como está ahora, con este algoritmo?
+static bool encrypt_key_matches(const struct encrypt_key *key, struct inode *inode,
+                                const struct encrypt_key_stamp *stamp, unsigned int alg)
+{
+    return key->alg == alg && key->ino == inode->i_ino && key->dev == inode->i_sb->s_dev &&
+           key->size == i_size_read(inode) && encrypt_key_stamp_equal(&key->stamp, stamp);
+}
+
+// Saca las menos usadas hasta que queden 'max'. Con encrypt_key_cache_lock tomado.
+static void encrypt_key_cache_trim(unsigned int max)
+{
+    struct encrypt_key *key;
+
+    while (encrypt_key_cache_count > max) {
+        key = list_last_entry(&encrypt_key_cache, struct encrypt_key, lru);
+        list_del_init(&key->lru);
+        encrypt_key_cache_count--;
+        encrypt_key_cache_evictions++;
+        encrypt_key_put(key);
+    }
+}
+
+// Busca la clave del archivo sin abrirlo. Devuelve una referencia o NULL.
+static struct encrypt_key *encrypt_key_cache_get(const char *key_filepath, unsigned int alg)
+{
+    struct encrypt_key *key, *found = NULL;
+    struct encrypt_key_stamp stamp;
+    struct inode *inode;
+    struct path path;
+
+    if (!READ_ONCE(encrypt_key_cache_size))
+        return NULL;
+    if (kern_path(key_filepath, LOOKUP_FOLLOW, &path))
+        return NULL;
+    inode = d_inode(path.dentry);
+    // filp_open revisaba que quien llama pueda leer la clave: aquí también
+    if (inode_permission(mnt_idmap(path.mnt), inode, MAY_READ))
+        goto put_path;
+    encrypt_key_stamp_get(inode, &stamp);
+
+    mutex_lock(&encrypt_key_cache_lock);
+    list_for_each_entry(key, &encrypt_key_cache, lru) {
+        if (encrypt_key_matches(key, inode, &stamp, alg)) {
+            list_move(&key->lru, &encrypt_key_cache);
+            kref_get(&key->ref);
+            found = key;
+            break;
+        }
+    }
+    if (found)
+        encrypt_key_cache_hits++;
+    else
+        encrypt_key_cache_misses++;
+    mutex_unlock(&encrypt_key_cache_lock);
+
+put_path:
+    path_put(&path);
+    return found;
+}
+
+// Guarda una clave recién leída. 'stamp' es la de antes de leerla: si el
+// archivo cambió mientras lo leíamos, no se guarda.
+static void encrypt_key_cache_add(struct encrypt_key *key, struct inode *inode,
+                                  const struct encrypt_key_stamp *stamp)
+{
+    unsigned int max = READ_ONCE(encrypt_key_cache_size);
+    struct encrypt_key_stamp now;
+    struct encrypt_key *old;
+
+    if (!max)
+        return;
+    encrypt_key_stamp_get(inode, &now);
+    if (!encrypt_key_stamp_equal(&now, stamp))
+        return;
+    key->dev = inode->i_sb->s_dev;
+    key->ino = inode->i_ino;
+    key->stamp = *stamp;
+    key->size = i_size_read(inode);
+
+    mutex_lock(&encrypt_key_cache_lock);
+    // Otra llamada pudo leer la misma clave al mismo tiempo
+    list_for_each_entry(old, &encrypt_key_cache, lru) {
+        if (encrypt_key_matches(old, inode, stamp, key->alg))
+            goto unlock;
+    }
+    kref_get(&key->ref); // La referencia de la caché
+    list_add(&key->lru, &encrypt_key_cache);
+    encrypt_key_cache_count++;
+    // key_cache pudo bajar en /sys: se ajusta aquí
+    encrypt_key_cache_trim(max);
+unlock:
+    mutex_unlock(&encrypt_key_cache_lock);
+}
+
+// Vacía la caché (echo flush > /proc/my_encrypt_keys)
+static void encrypt_key_cache_flush(void)
+{
+    mutex_lock(&encrypt_key_cache_lock);
+    encrypt_key_cache_trim(0);
+    mutex_unlock(&encrypt_key_cache_lock);
+}
+
+// Modo cifrado: carga la clave en un tfm de "ctr(aes)" o "chacha20".
+// El archivo es la clave seguida del IV (ver my_encrypt.h).
+static int encrypt_key_setup_cipher(struct encrypt_key *key, const u8 *material, size_t length)
+{
+    size_t key_bytes = length - MY_ENCRYPT_IV_SIZE;
+    const char *name;
+    int ret;
+
+    if (length <= MY_ENCRYPT_IV_SIZE)
+        return -EINVAL;
+    if (key->alg == MY_ENCRYPT_ALG_AES_CTR) {
+        if (key_bytes != AES_KEYSIZE_128 && key_bytes != AES_KEYSIZE_192 && key_bytes != AES_KEYSIZE_256)
+            return -EINVAL;
+        name = "ctr(aes)";
+    } else {
+        if (key_bytes != CHACHA_KEY_SIZE)
+            return -EINVAL;
+        name = "chacha20";
+    }
+
+    // El crypto API elige la implementación de mayor prioridad (AES-NI, AVX2, ...)
+    key->tfm = crypto_alloc_skcipher(name, 0, 0);
+    if (IS_ERR(key->tfm)) {
+        ret = PTR_ERR(key->tfm);
+        key->tfm = NULL;
+        return ret;
+    }
+    ret = crypto_skcipher_setkey(key->tfm, material, key_bytes);
+    if (ret)
+        return ret;
+    memcpy(key->iv, material + key_bytes, MY_ENCRYPT_IV_SIZE);
+
+    if (READ_ONCE(encrypt_debug))
+        printk(KERN_INFO "my_encrypt: %s -> %s\n", name, crypto_skcipher_driver_name(key->tfm));
+    return 0;
+}
+
+// 2. LEER LA CLAVE
+// Abre el archivo de la clave, la lee y la expande (o la carga en el tfm del
+// algoritmo pedido en 'flags'), salvo que ya esté en la caché.
+// Devuelve ERR_PTR si falla.
+static struct encrypt_key *encrypt_key_load(const char *key_filepath, unsigned int flags)
+{
+    struct file *key_file;
+    loff_t key_offset = 0; // Posición de lectura (cursor) de la clave
+    unsigned char *encryption_key; // Buffer para guardar la clave en RAM
+    struct encrypt_key *key;
+    struct encrypt_key_stamp stamp;
+    size_t key_length = 0;
+    ssize_t ret;
+    unsigned int alg = flags & MY_ENCRYPT_ALG_MASK;
+    bool cached = false;
+    u64 start_ns = ktime_get_ns();
+
+    if (alg != MY_ENCRYPT_ALG_XOR && alg != MY_ENCRYPT_ALG_AES_CTR && alg != MY_ENCRYPT_ALG_CHACHA20)
+        return ERR_PTR(-EINVAL);
+
+    // Si el archivo no cambió desde la última vez, no hace falta abrirlo
+    key = encrypt_key_cache_get(key_filepath, alg);
+    if (key) {
+        key_length = key->length;
+        cached = true;
+        goto out;
+    }
+
+    key_file = filp_open(key_filepath, O_RDONLY, 0);
     if (IS_ERR(key_file)) {
-        ret_val = PTR_ERR(key_file);
-        goto close_output_file;
+        key = ERR_CAST(key_file);
+        goto out;
     }
+    encrypt_key_stamp_get(file_inode(key_file), &stamp);
 
-    // 2. LEER LA CLAVE
     // Obtenemos el tamaño del archivo de la clave
     key_length = i_size_read(file_inode(key_file));
     if (key_length <= 0) {
-        ret_val = -EINVAL;
+        key = ERR_PTR(-EINVAL);
         goto close_key_file;
     }
 
     // kmalloc: Reservamos memoria RAM del kernel para guardar la clave
     encryption_key = kmalloc(key_length, GFP_KERNEL);
     if (!encryption_key) {
-        ret_val = -ENOMEM; // Error: No hay memoria RAM suficiente
+        key = ERR_PTR(-ENOMEM); // Error: No hay memoria RAM suficiente
         goto close_key_file;
     }
 
     // Leemos el contenido del archivo de clave a la RAM
-    ret_val = kernel_read(key_file, encryption_key, key_length, &key_offset);
-    if (ret_val < 0) goto free_encryption_key;
+    ret = kernel_read(key_file, encryption_key, key_length, &key_offset);
+    if (ret <= 0) {
+        key = ERR_PTR(ret < 0 ? ret : -EINVAL);
+        goto free_encryption_key;
+    }
+    // Si se leyó menos de lo esperado, la clave es lo que realmente se leyó
+    key_length = ret;
 
-    // 3. LEER EL ARCHIVO DE ENTRADA (DATOS A CIFRAR)
-    file_size = i_size_read(file_inode(input_file));
-    if (file_size <= 0) {
-        ret_val = -EINVAL;
+    key = kzalloc(sizeof(*key), GFP_KERNEL);
+    if (!key) {
+        key = ERR_PTR(-ENOMEM);
         goto free_encryption_key;
     }
+    kref_init(&key->ref);
+    INIT_LIST_HEAD(&key->lru);
+    key->alg = alg;
+    if (alg != MY_ENCRYPT_ALG_XOR) {
+        ret = encrypt_key_setup_cipher(key, encryption_key, key_length);
+        if (ret) {
+            encrypt_key_put(key);
+            key = ERR_PTR(ret);
+        }
+        goto free_encryption_key;
+    }
+    key->length = key_length;
+    key->span = xor_key_span(key_length);
 
-    // Reservamos RAM para TODO el archivo de entrada
-    file_buffer = kmalloc(file_size, GFP_KERNEL);
-    if (!file_buffer) {
-        ret_val = -ENOMEM;
+    // Expandimos la clave una sola vez (para toda la llamada o todo el lote)
+    key->stream = kmalloc(key->span, GFP_KERNEL);
+    if (!key->stream) {
+        kfree_sensitive(key);
+        key = ERR_PTR(-ENOMEM);
         goto free_encryption_key;
     }
+    xor_key_expand(key->stream, encryption_key, key_length);
 
-    // Leemos todo el archivo a la memoria RAM (file_buffer)
-    ret_val = kernel_read(input_file, file_buffer, file_size, &in_offset);
-    if (ret_val < 0) goto free_file_buffer;
+free_encryption_key:
+    kfree_sensitive(encryption_key);
+    if (!IS_ERR(key))
+        encrypt_key_cache_add(key, file_inode(key_file), &stamp);
 
-    // 4. PREPARAR HILOS (MULTITHREADING)
-    // Asignamos memoria para las listas de control de hilos
-    thread_list = kmalloc(sizeof(struct task_struct *) * thread_count, GFP_KERNEL);
-    task_list = kmalloc(sizeof(struct task_params) * thread_count, GFP_KERNEL);
-    fragment_list = kmalloc(sizeof(DataFragment) * thread_count, GFP_KERNEL);
+close_key_file:
+    filp_close(key_file, NULL);
 
-    if (!thread_list || !task_list || !fragment_list) {
-        ret_val = -ENOMEM;
-        goto free_file_buffer;
+out:
+    trace_encrypt_key_read(key_length, alg, cached, ktime_get_ns() - start_ns, PTR_ERR_OR_ZERO(key));
+    return key;
+}
+
+// Anota la llamada en /proc/my_encrypt_jobs
+static void encrypt_job_register(struct encrypt_job_stats *stats, const char *input_filepath,
+                                 const struct encrypt_owner *owner)
+{
+    stats->pid = owner->pid;
+    strscpy(stats->comm, owner->comm, sizeof(stats->comm));
+    strscpy(stats->name, kbasename(input_filepath), sizeof(stats->name));
+
+    spin_lock(&encrypt_jobs_lock);
+    list_add_tail(&stats->node, &encrypt_jobs_active);
+    spin_unlock(&encrypt_jobs_lock);
+}
+
+// La saca de los trabajos en curso y guarda una copia entre los recientes
+static void encrypt_job_unregister(struct encrypt_job_stats *stats, int result)
+{
+    stats->end_ns = ktime_get_ns();
+    stats->result = result;
+
+    spin_lock(&encrypt_jobs_lock);
+    list_del(&stats->node);
+    encrypt_jobs_recent[encrypt_jobs_recent_next++ % ENCRYPT_RECENT_JOBS] = *stats;
+    spin_unlock(&encrypt_jobs_lock);
+}
+
+// 1. ABRIR ARCHIVOS
+// Siempre en el hilo de la syscall: filp_open usa los permisos y el directorio
+// actual de quien llama. Un trabajador del pool es un hilo del kernel (root,
+// con "/" como directorio) y abriría cualquier archivo que le pidan.
+// En modo in-place la entrada también es la salida. Devuelve 0 o -errno.
+static int encrypt_open_files(const char *input_filepath, const char *output_filepath, unsigned int flags,
+                              struct file **input_out, struct file **output_out)
+{
+    struct file *input_file, *output_file; // Punteros a los archivos en el kernel
+    u64 start_ns = ktime_get_ns();
+    int ret_val;
+
+    // filp_open es como fopen pero en espacio de kernel.
+    input_file = filp_open(input_filepath, (flags & MY_ENCRYPT_F_INPLACE) ? O_RDWR : O_RDONLY, 0);
+
+    // Verificación de errores al abrir archivos (IS_ERR verifica punteros inválidos)
+    if (IS_ERR(input_file)) {
+        ret_val = PTR_ERR(input_file);
+        printk(KERN_ERR "Error al abrir el archivo de entrada: %d\n", ret_val);
+        return ret_val;
     }
 
-    // Calculamos cuánto trabajo le toca a cada hilo
-    fragment_size = file_size / thread_count;
-    extra_bytes = file_size % thread_count; // Lo que sobra si la división no es exacta
+    if (flags & MY_ENCRYPT_F_INPLACE) {
+        // Misma estructura 'file' para leer y escribir; get_file suma una referencia
+        // para que cerrar "las dos" sea correcto. No se trunca: se sobrescribe bloque a bloque.
+        output_file = get_file(input_file);
+    } else {
+        // Para salida usamos O_CREAT (crear si no existe) y O_TRUNC (borrar contenido previo)
+        output_file = filp_open(output_filepath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    }
+    if (IS_ERR(output_file)) {
+        filp_close(input_file, NULL);
+        return PTR_ERR(output_file);
+    }
+
+    trace_encrypt_open(input_filepath, i_size_read(file_inode(input_file)), flags, ktime_get_ns() - start_ns);
+    *input_out = input_file;
+    *output_out = output_file;
+    return 0;
+}
 
-    // Bucle para crear y lanzar cada hilo
-    for (i = 0; i < thread_count; i++) {
-        // Configuramos los datos que este hilo específico va a usar
-        fragment_list[i].buffer = file_buffer; // Todos apuntan al mismo buffer gigante
-        fragment_list[i].data_size = file_size;
-        fragment_list[i].encryption_key = encryption_key;
-        fragment_list[i].key_length = key_length;
-        
-        // Calculamos dónde empieza y termina este hilo
-        fragment_list[i].start_idx = i * fragment_size;
-        // El último hilo se lleva los bytes extra que sobraron
-        fragment_list[i].end_idx = (i == thread_count - 1) ? (i + 1) * fragment_size + extra_bytes : (i + 1) * fragment_size;
+// Cifra input_file en output_file (ya abiertos con encrypt_open_files) y los cierra.
+// 'input_filepath' y 'owner' solo se usan para /proc/my_encrypt_jobs.
+static int encrypt_files(struct file *input_file, struct file *output_file, const char *input_filepath,
+                         const struct encrypt_owner *owner, struct encrypt_key *key, int thread_count,
+                         unsigned int flags) {
+    size_t file_size;
 
-        task_list[i].data_fragment = fragment_list[i];
-        init_completion(&task_list[i].completed_event); // Inicializamos el semáforo/aviso
+    // Pipeline y array de trabajos para el pool
+    struct encrypt_pipeline pipe = {};
+    unsigned int chunk_kb;
 
-        // kthread_run crea y arranca el hilo inmediatamente ejecutando 'perform_xor_operation'
-        thread_list[i] = kthread_run(perform_xor_operation, &task_list[i], "xor_thread_%d", i);
-        if (IS_ERR(thread_list[i])) {
-            
-            ret_val = PTR_ERR(thread_list[i]);
-            goto free_all_resources;
-        }
+    int i, ret_val = 0;
+
+    pipe.stats.start_ns = ktime_get_ns();
+
+    // Sin page cache que leer, el modo zero-copy cae a kernel_read (mismo resultado)
+    if ((flags & MY_ENCRYPT_F_ZEROCOPY) && !encrypt_can_zerocopy(input_file))
+        flags &= ~MY_ENCRYPT_F_ZEROCOPY;
+
+    // (La clave ya viene leída: ver encrypt_key_load)
+
+    // 3. PREPARAR EL ANILLO DE BLOQUES
+    file_size = i_size_read(file_inode(input_file));
+    if (file_size <= 0) {
+        ret_val = -EINVAL;
+        goto close_output_file;
+    }
+    // ChaCha20 tiene un contador de 32 bits: no puede dar la vuelta dentro del archivo
+    if (key->alg == MY_ENCRYPT_ALG_CHACHA20 &&
+        get_unaligned_le32(key->iv) + DIV_ROUND_UP_ULL(file_size, CHACHA_BLOCK_SIZE) > (u64)U32_MAX + 1) {
+        ret_val = -EFBIG;
+        goto close_output_file;
     }
 
-    // 5. ESPERAR A LOS HILOS (SINCRONIZACIÓN)
-    // El hilo principal se detiene aquí hasta que todos los trabajadores terminen
-    for (i = 0; i < thread_count; i++) {
-        wait_for_completion(&task_list[i].completed_event);
+    // Leemos los parámetros una sola vez (pueden cambiar en /sys mientras corremos)
+    chunk_kb = clamp_t(unsigned int, READ_ONCE(encrypt_chunk_kb), 4, ENCRYPT_MAX_CHUNK_KB);
+    // Bloques de páginas completas: en modo zero-copy cada bloque empieza en una página
+    pipe.chunk_size = max_t(size_t, round_down((size_t)chunk_kb * 1024, PAGE_SIZE), PAGE_SIZE);
+    pipe.nr_chunks = DIV_ROUND_UP(file_size, pipe.chunk_size);
+    // No tiene sentido reservar más ranuras que bloques tiene el archivo
+    pipe.nr_slots = clamp_t(unsigned int, READ_ONCE(encrypt_ring_chunks), 2, 64);
+    pipe.nr_slots = min_t(long, pipe.nr_slots, pipe.nr_chunks);
+    pipe.key_stream = key->stream;
+    pipe.key_span = key->span;
+    pipe.key_length = key->length;
+    pipe.key = key;
+    pipe.thread_count = thread_count;
+    pipe.flags = flags;
+    pipe.output_file = output_file;
+    pipe.stats.size = file_size;
+    pipe.stats.threads = thread_count;
+    pipe.stats.flags = flags;
+    encrypt_job_register(&pipe.stats, input_filepath, owner);
+    init_waitqueue_head(&pipe.wq);
+    // inflight empieza en 1: es la referencia del lector, se suelta al final
+    atomic_set(&pipe.inflight, 1);
+    init_completion(&pipe.idle);
+    init_completion(&pipe.writer_done);
+
+    // kcalloc: como kmalloc pero deja todo en cero (todas las ranuras quedan CHUNK_FREE)
+    pipe.ring = kcalloc(pipe.nr_slots, sizeof(*pipe.ring), GFP_KERNEL);
+    // Un trabajo por cada parte de cada ranura; se reutilizan vuelta tras vuelta
+    pipe.tasks = kcalloc(pipe.nr_slots, thread_count * sizeof(*pipe.tasks), GFP_KERNEL);
+    pipe.cpus = kmalloc_array(thread_count, sizeof(*pipe.cpus), GFP_KERNEL);
+    if (!pipe.ring || !pipe.tasks || !pipe.cpus) {
+        ret_val = -ENOMEM;
+        goto free_ring;
     }
+    pick_cpus(pipe.cpus, thread_count);
 
-    // 6. GUARDAR RESULTADO
-    // Una vez que todos los hilos modificaron 'file_buffer', lo escribimos al disco
-    ret_val = kernel_write(output_file, file_buffer, file_size, &out_offset);
-    if (ret_val < 0) {
-        printk(KERN_ERR "Error al escribir en salida: %d\n", ret_val);
+    // Reservamos el buffer de cada ranura: esta es TODA la memoria de datos que se usa
+    for (i = 0; i < pipe.nr_slots; i++) {
+        pipe.ring[i].seq = -1;
+        // Buffers en el nodo NUMA local: las partes van primero a CPUs de este nodo
+        pipe.ring[i].data = kmalloc_node(pipe.chunk_size, GFP_KERNEL, numa_node_id());
+        if (!pipe.ring[i].data) {
+            ret_val = -ENOMEM;
+            goto free_ring;
+        }
+        // En zero-copy cada ranura guarda además las páginas de la entrada que cubre
+        if (flags & MY_ENCRYPT_F_ZEROCOPY) {
+            pipe.ring[i].folios = kcalloc(pipe.chunk_size >> PAGE_SHIFT, sizeof(struct folio *), GFP_KERNEL);
+            if (!pipe.ring[i].folios) {
+                ret_val = -ENOMEM;
+                goto free_ring;
+            }
+        }
     }
 
-// 7. LIMPIEZA DE MEMORIA (GARBAGE COLLECTION MANUAL)
-// En C y Kernel, debes liberar todo lo que reservaste con kmalloc
-free_all_resources:
-    kfree(thread_list);
-    kfree(task_list);
-    kfree(fragment_list);
+    // 4. PREPARAR LOS TRABAJOS PARA EL POOL (MULTITHREADING)
+    // Ya no creamos hilos: cada parte de cada bloque es un trabajo que se
+    // encola en los trabajadores que ya existen (uno por CPU).
+    for (i = 0; i < pipe.nr_slots * thread_count; i++) {
+        INIT_WORK(&pipe.tasks[i].work, perform_xor_operation);
+        pipe.tasks[i].pipe = &pipe;
+        pipe.tasks[i].index = i % thread_count;
 
-free_file_buffer:
-    kfree(file_buffer);
+        // Modo cifrado: cada trabajo reutiliza su propia petición en todos los bloques
+        if (!key->tfm)
+            continue;
+        pipe.tasks[i].req = skcipher_request_alloc(key->tfm, GFP_KERNEL);
+        if (flags & MY_ENCRYPT_F_ZEROCOPY)
+            pipe.tasks[i].src_sg = kmalloc_array(pipe.chunk_size >> PAGE_SHIFT,
+                                                 sizeof(struct scatterlist), GFP_KERNEL);
+        if (!pipe.tasks[i].req || ((flags & MY_ENCRYPT_F_ZEROCOPY) && !pipe.tasks[i].src_sg)) {
+            ret_val = -ENOMEM;
+            goto free_ring;
+        }
+    }
 
-free_encryption_key:
-    kfree(encryption_key);
+    // El escritor también corre aparte, así no frena a los demás
+    INIT_WORK_ONSTACK(&pipe.write_work, write_chunks);
+    queue_work(encrypt_io_wq, &pipe.write_work);
 
-close_key_file:
-    filp_close(key_file, NULL);
+    // 5. LEER EL ARCHIVO DE ENTRADA POR BLOQUES
+    // Mientras este hilo lee el bloque N+1, el pool cifra el bloque N
+    // y el escritor guarda el bloque N-1.
+    read_chunks(&pipe, input_file, file_size);
+
+    // 6. ESPERAR AL POOL (SINCRONIZACIÓN)
+    // El escritor termina cuando guardó el último bloque (o cuando hubo un error)
+    wait_for_completion(&pipe.writer_done);
+    destroy_work_on_stack(&pipe.write_work);
+    // Soltamos la referencia del lector y esperamos a que ningún trabajo siga vivo
+    pipeline_put(&pipe);
+    wait_for_completion(&pipe.idle);
+    ret_val = READ_ONCE(pipe.error);
+
+    if (READ_ONCE(encrypt_debug))
+        printk(KERN_INFO "my_encrypt: %zu bytes, %ld bloques, %d partes por bloque, %lld fragmentos en total\n",
+               file_size, pipe.nr_chunks, thread_count, (long long)atomic64_read(&encrypt_fragments_done));
+
+// 7. LIMPIEZA DE MEMORIA (GARBAGE COLLECTION MANUAL)
+// En C y Kernel, debes liberar todo lo que reservaste con kmalloc
+free_ring:
+    if (pipe.ring) {
+        for (i = 0; i < pipe.nr_slots; i++) {
+            // Si hubo un error, alguna ranura pudo quedar con páginas retenidas
+            chunk_release_folios(&pipe.ring[i]);
+            kfree(pipe.ring[i].folios);
+            kfree(pipe.ring[i].data);
+        }
+    }
+    kfree(pipe.ring);
+    if (pipe.tasks) {
+        for (i = 0; i < pipe.nr_slots * thread_count; i++) {
+            skcipher_request_free(pipe.tasks[i].req); // Borra el contexto (puede tener estado de la clave)
+            kfree(pipe.tasks[i].src_sg);
+        }
+    }
+    kfree(pipe.tasks);
+    kfree(pipe.cpus);
+    encrypt_job_unregister(&pipe.stats, ret_val);
 
 close_output_file:
     filp_close(output_file, NULL);
-
-close_input_file:
     filp_close(input_file, NULL);
 
-exit:
+    trace_encrypt_done(file_size, thread_count, ktime_get_ns() - pipe.stats.start_ns, pipe.stats.read_ns,
+                       atomic64_read(&pipe.stats.xor_ns), pipe.stats.write_ns, ret_val);
     return ret_val;
 }
 
-// Definición de la System Call (lo que llama el usuario)
-SYSCALL_DEFINE4(my_encrypt, const char __user *, input_filepath, const char __user *, output_filepath, const char __user *, key_filepath, int, thread_count) {
-    char *k_input_filepath, *k_output_filepath, *k_key_filepath;
+// Cifrado síncrono (my_encrypt y my_encrypt_ex): abre y cifra en el hilo de la syscall
+int handle_file_encryption(const char *input_filepath, const char *output_filepath, struct encrypt_key *key, int thread_count, unsigned int flags) {
+    struct file *input_file, *output_file;
+    struct encrypt_owner owner;
     int ret_val;
 
+    ret_val = encrypt_open_files(input_filepath, output_filepath, flags, &input_file, &output_file);
+    if (ret_val)
+        return ret_val;
+    encrypt_owner_current(&owner);
+    return encrypt_files(input_file, output_file, input_filepath, &owner, key, thread_count, flags);
+}
+
+// Crea el pool una sola vez, al arrancar el kernel.
+static int __init encrypt_pool_init(void)
+{
+    // WQ_CPU_INTENSIVE: el XOR usa CPU de forma continua.
+    // max_active = 1: como mucho un trabajo XOR a la vez por CPU en línea.
+    encrypt_wq = alloc_workqueue("encrypt_xor", WQ_CPU_INTENSIVE, 1);
+    // El escritor se bloquea en disco, puede correr en cualquier CPU
+    encrypt_io_wq = alloc_workqueue("encrypt_io", WQ_UNBOUND, 0);
+    // Los archivos de un lote van en otra cola: esperan a su escritor (en encrypt_io)
+    // y si compartieran cola podrían ocupar todos los lugares y bloquearse entre sí
+    encrypt_job_wq = alloc_workqueue("encrypt_job", WQ_UNBOUND,
+                                     clamp_t(unsigned int, encrypt_batch_jobs, 1, WQ_MAX_ACTIVE));
+    if (!encrypt_wq || !encrypt_io_wq || !encrypt_job_wq) {
+        printk(KERN_ERR "my_encrypt: no se pudo crear el pool de trabajadores\n");
+        return -ENOMEM;
+    }
+    return 0;
+}
+late_initcall(encrypt_pool_init);
+
+// Una línea de /proc/my_encrypt_jobs. MB/s = bytes * 1000 / ns.
+static void encrypt_job_show(struct seq_file *m, const struct encrypt_job_stats *stats, u64 now)
+{
+    u64 elapsed = (stats->end_ns ? stats->end_ns : now) - stats->start_ns;
+    u64 bytes = stats->end_ns ? stats->size : READ_ONCE(stats->bytes_done);
+
+    seq_printf(m, "%-6s %7d %-16s %-32s %12zu %5d 0x%03x %10llu %8llu %10llu %10llu %10llu %6d\n",
+               stats->end_ns ? "hecho" : "activo", stats->pid, stats->comm, stats->name,
+               stats->size, stats->threads, stats->flags,
+               div_u64(elapsed, NSEC_PER_MSEC),
+               elapsed ? div64_u64(bytes * 1000, elapsed) : 0,
+               div_u64(READ_ONCE(stats->read_ns), NSEC_PER_MSEC),
+               div_u64(atomic64_read(&stats->xor_ns), NSEC_PER_MSEC),
+               div_u64(READ_ONCE(stats->write_ns), NSEC_PER_MSEC),
+               stats->result);
+}
+
+// Trabajos en curso y los últimos ENCRYPT_RECENT_JOBS terminados, del más viejo al más nuevo
+static int encrypt_jobs_proc_show(struct seq_file *m, void *v)
+{
+    struct encrypt_job_stats *stats;
+    u64 now = ktime_get_ns();
+    unsigned int i, n;
+
+    seq_printf(m, "%-6s %7s %-16s %-32s %12s %5s %5s %10s %8s %10s %10s %10s %6s\n",
+               "estado", "pid", "comm", "archivo", "bytes", "hilos", "flags",
+               "ms", "MB/s", "leer_ms", "xor_ms", "escr_ms", "error");
+
+    spin_lock(&encrypt_jobs_lock);
+    n = min_t(unsigned int, encrypt_jobs_recent_next, ENCRYPT_RECENT_JOBS);
+    for (i = encrypt_jobs_recent_next - n; i != encrypt_jobs_recent_next; i++)
+        encrypt_job_show(m, &encrypt_jobs_recent[i % ENCRYPT_RECENT_JOBS], now);
+    list_for_each_entry(stats, &encrypt_jobs_active, node)
+        encrypt_job_show(m, stats, now);
+    spin_unlock(&encrypt_jobs_lock);
+    return 0;
+}
+
+// Estado de la caché de claves
+static int encrypt_keys_proc_show(struct seq_file *m, void *v)
+{
+    mutex_lock(&encrypt_key_cache_lock);
+    seq_printf(m, "entradas:  %u/%u\naciertos:  %llu\nfallos:    %llu\ndesalojos: %llu\n",
+               encrypt_key_cache_count, READ_ONCE(encrypt_key_cache_size),
+               encrypt_key_cache_hits, encrypt_key_cache_misses, encrypt_key_cache_evictions);
+    mutex_unlock(&encrypt_key_cache_lock);
+    return 0;
+}
+
+static int encrypt_keys_proc_open(struct inode *inode, struct file *file)
+{
+    return single_open(file, encrypt_keys_proc_show, NULL);
+}
+
+// "flush": saca todas las claves de la caché (p. ej. después de rotarlas)
+static ssize_t encrypt_keys_proc_write(struct file *file, const char __user *buf, size_t count, loff_t *ppos)
+{
+    char cmd[8] = {};
+
+    if (count >= sizeof(cmd))
+        return -EINVAL;
+    if (copy_from_user(cmd, buf, count))
+        return -EFAULT;
+    if (!sysfs_streq(cmd, "flush"))
+        return -EINVAL;
+    encrypt_key_cache_flush();
+    return count;
+}
+
+static const struct proc_ops encrypt_keys_proc_ops = {
+    .proc_open = encrypt_keys_proc_open,
+    .proc_read = seq_read,
+    .proc_lseek = seq_lseek,
+    .proc_release = single_release,
+    .proc_write = encrypt_keys_proc_write,
+};
+
+static int __init encrypt_proc_init(void)
+{
+    if (!proc_create_single("my_encrypt_jobs", 0444, NULL, encrypt_jobs_proc_show))
+        printk(KERN_ERR "my_encrypt: no se pudo crear /proc/my_encrypt_jobs\n");
+    // Solo root puede vaciar la caché
+    if (!proc_create("my_encrypt_keys", 0644, NULL, &encrypt_keys_proc_ops))
+        printk(KERN_ERR "my_encrypt: no se pudo crear /proc/my_encrypt_keys\n");
+    return 0;
+}
+late_initcall(encrypt_proc_init);
+
+// Copia las rutas del usuario y llama a handle_file_encryption.
+// Compartida por my_encrypt y my_encrypt_ex.
+static long do_my_encrypt(const char __user *input_filepath, const char __user *output_filepath,
+                          const char __user *key_filepath, int thread_count, unsigned int flags) {
+    char *k_input_filepath, *k_output_filepath = NULL, *k_key_filepath;
+    struct encrypt_key *key;
+    int ret_val;
+
+    // Sin hilos no hay trabajo que repartir (y evitamos dividir entre cero)
+    if (thread_count <= 0)
+        return -EINVAL;
+    thread_count = encrypt_clamp_threads(thread_count);
+    // Si el pool no se pudo crear al arrancar, no hay quién haga el trabajo
+    if (!encrypt_wq || !encrypt_io_wq)
+        return -ENOMEM;
+    // Banderas desconocidas: error, así en el futuro se pueden agregar nuevas sin ambigüedad
+    if (flags & ~MY_ENCRYPT_F_ALL)
+        return -EINVAL;
+
     // COPIAR DATOS DE USUARIO A KERNEL
     // strndup_user copia las cadenas de texto (rutas) de forma segura.
     // El kernel no puede leer directamente la memoria del usuario sin riesgo.
     k_input_filepath = strndup_user(input_filepath, PATH_MAX);
-    k_output_filepath = strndup_user(output_filepath, PATH_MAX);
+    // En modo in-place la ruta de salida no se usa (puede venir NULL)
+    if (!(flags & MY_ENCRYPT_F_INPLACE))
+        k_output_filepath = strndup_user(output_filepath, PATH_MAX);
     k_key_filepath = strndup_user(key_filepath, PATH_MAX);
 
     // Verificar si falló la copia
@@ -222,14 +1316,343 @@ SYSCALL_DEFINE4(my_encrypt, const char __user *, input_filepath, const char __us
         goto free_memory;
     }
 
-    // Llamar a la función lógica definida arriba
-    ret_val = handle_file_encryption(k_input_filepath, k_output_filepath, k_key_filepath, thread_count);
+    // Leer la clave y llamar a la función lógica definida arriba
+    key = encrypt_key_load(k_key_filepath, flags);
+    if (IS_ERR(key)) {
+        ret_val = PTR_ERR(key);
+        goto free_memory;
+    }
+    ret_val = handle_file_encryption(k_input_filepath, k_output_filepath, key, thread_count, flags);
+    encrypt_key_put(key);
 
 free_memory:
-   
-    kfree(k_input_filepath);
+    // strndup_user devuelve ERR_PTR si falla: eso no se puede pasar a kfree
+    if (!IS_ERR(k_input_filepath))
+        kfree(k_input_filepath);
+    if (!IS_ERR(k_output_filepath))
+        kfree(k_output_filepath);
+    if (!IS_ERR(k_key_filepath))
+        kfree(k_key_filepath);
+
+    return ret_val;
+}
+
+// Definición de la System Call (lo que llama el usuario)
+SYSCALL_DEFINE4(my_encrypt, const char __user *, input_filepath, const char __user *, output_filepath, const char __user *, key_filepath, int, thread_count) {
+    return do_my_encrypt(input_filepath, output_filepath, key_filepath, thread_count, 0);
+}
+
+// Variante con banderas (MY_ENCRYPT_F_*): in-place, lectura directa de la page cache
+// y algoritmo (MY_ENCRYPT_ALG_*: XOR, AES-CTR o ChaCha20)
+SYSCALL_DEFINE5(my_encrypt_ex, const char __user *, input_filepath, const char __user *, output_filepath, const char __user *, key_filepath, int, thread_count, unsigned int, flags) {
+    return do_my_encrypt(input_filepath, output_filepath, key_filepath, thread_count, flags);
+}
+
+
+// --- LOTES: muchos archivos, una sola clave, una sola syscall ---
+
+// Un archivo del lote (o un trabajo asíncrono): se cifra en encrypt_job_wq, en paralelo con los demás.
+struct encrypt_job {
+    struct work_struct work;
+    char *input_filepath;         // Solo para /proc/my_encrypt_jobs
+    struct file *input_file;      // Abiertos en la syscall (ver encrypt_job_open);
+    struct file *output_file;     // el trabajador los cierra
+    struct encrypt_owner owner;   // Quién llamó a la syscall (no el kworker)
+    struct encrypt_key *key;      // Referencia a la clave compartida
+    int thread_count;
+    unsigned int flags;
+    int result;                   // 0 o -errno
+    struct completion done;
+    // Si no es NULL, se llama al terminar en lugar de solo completar 'done'
+    void (*done_fn)(struct encrypt_job *job);
+};
+
+static void encrypt_job_work(struct work_struct *work)
+{
+    struct encrypt_job *job = container_of(work, struct encrypt_job, work);
+
+    job->result = encrypt_files(job->input_file, job->output_file, job->input_filepath, &job->owner,
+                                job->key, job->thread_count, job->flags);
+    encrypt_key_put(job->key);
+    if (job->done_fn)
+        job->done_fn(job);
+    else
+        complete(&job->done);
+}
+
+// Copia las rutas de un trabajo desde el usuario y abre los archivos aquí,
+// en la syscall, antes de encolarlo (ver encrypt_open_files); devuelve 0 o -errno
+static int encrypt_job_open(struct encrypt_job *job, const char __user *input_filepath,
+                            const char __user *output_filepath)
+{
+    char *k_output_filepath = NULL;
+    int err;
+
+    encrypt_owner_current(&job->owner);
+    job->input_filepath = strndup_user(input_filepath, PATH_MAX);
+    if (IS_ERR(job->input_filepath)) {
+        err = PTR_ERR(job->input_filepath);
+        job->input_filepath = NULL;
+        return err;
+    }
+    if (!(job->flags & MY_ENCRYPT_F_INPLACE)) {
+        k_output_filepath = strndup_user(output_filepath, PATH_MAX);
+        if (IS_ERR(k_output_filepath))
+            return PTR_ERR(k_output_filepath);
+    }
+
+    err = encrypt_open_files(job->input_filepath, k_output_filepath, job->flags,
+                             &job->input_file, &job->output_file);
     kfree(k_output_filepath);
+    return err;
+}
+
+// Cifra 'count' archivos con la misma clave. La clave se lee UNA vez, los
+// archivos se reparten entre batch_jobs trabajadores y todos comparten el pool XOR.
+// El resultado de cada archivo queda en entries[i].status.
+// Devuelve cuántos archivos fallaron (0 = todos bien) o -errno si falló el lote entero.
+SYSCALL_DEFINE5(my_encrypt_batch, struct my_encrypt_batch_entry __user *, entries, unsigned int, count,
+                const char __user *, key_filepath, int, thread_count, unsigned int, flags) {
+    struct my_encrypt_batch_entry *k_entries;
+    struct encrypt_job *jobs;
+    struct encrypt_key *key;
+    char *k_key_filepath;
+    long ret_val = 0, failed = 0;
+    unsigned int i, window;
+
+    if (thread_count <= 0 || (flags & ~MY_ENCRYPT_F_ALL))
+        return -EINVAL;
+    thread_count = encrypt_clamp_threads(thread_count);
+    if (count == 0 || count > MY_ENCRYPT_BATCH_MAX)
+        return -E2BIG;
+    if (!encrypt_wq || !encrypt_io_wq || !encrypt_job_wq)
+        return -ENOMEM;
+
+    // 1. COPIAR EL LOTE Y LEER LA CLAVE (una sola vez para todos los archivos)
+    k_entries = vmemdup_array_user(entries, count, sizeof(*k_entries));
+    if (IS_ERR(k_entries))
+        return PTR_ERR(k_entries);
+
+    jobs = kvcalloc(count, sizeof(*jobs), GFP_KERNEL);
+    if (!jobs) {
+        ret_val = -ENOMEM;
+        goto free_entries;
+    }
+
+    k_key_filepath = strndup_user(key_filepath, PATH_MAX);
+    if (IS_ERR(k_key_filepath)) {
+        ret_val = PTR_ERR(k_key_filepath);
+        goto free_jobs;
+    }
+    key = encrypt_key_load(k_key_filepath, flags);
+    kfree(k_key_filepath);
+    if (IS_ERR(key)) {
+        ret_val = PTR_ERR(key);
+        goto free_jobs;
+    }
+
+    // 2. ENCOLAR UN TRABAJO POR ARCHIVO
+    // Los archivos se abren aquí, así que no adelantamos más que 'window' trabajos
+    // a los que están corriendo: a lo sumo 2 * window archivos abiertos a la vez
+    window = 2 * clamp_t(unsigned int, encrypt_batch_jobs, 1, WQ_MAX_ACTIVE);
+    for (i = 0; i < count; i++) {
+        struct encrypt_job *job = &jobs[i];
+
+        if (i >= window)
+            wait_for_completion(&jobs[i - window].done);
+
+        INIT_WORK(&job->work, encrypt_job_work);
+        init_completion(&job->done);
+        job->thread_count = thread_count;
+        job->flags = flags;
+        job->key = key;
+
+        // Si este archivo no se puede abrir, solo él falla
+        job->result = encrypt_job_open(job, u64_to_user_ptr(k_entries[i].input),
+                                       u64_to_user_ptr(k_entries[i].output));
+        if (job->result) {
+            complete(&job->done);
+            continue;
+        }
+        // Cada trabajo tiene su referencia a la clave y la suelta al terminar
+        kref_get(&key->ref);
+        queue_work(encrypt_job_wq, &job->work);
+    }
+
+    // 3. ESPERAR A TODOS Y DEVOLVER EL ESTADO DE CADA ARCHIVO
+    for (i = 0; i < count; i++) {
+        struct encrypt_job *job = &jobs[i];
+
+        // Los primeros count - window ya se esperaron al encolar
+        if (i + window >= count)
+            wait_for_completion(&job->done);
+        if (job->result)
+            failed++;
+        if (put_user(job->result, &entries[i].status))
+            ret_val = -EFAULT;
+        kfree(job->input_filepath);
+    }
+    encrypt_key_put(key);
+    if (!ret_val)
+        ret_val = failed;
+
+free_jobs:
+    kvfree(jobs);
+free_entries:
+    kvfree(k_entries);
+    return ret_val;
+}
+
+// --- MODO ASÍNCRONO: enviar y enterarse después ---
+// my_encrypt_submit devuelve de inmediato un descriptor de archivo. Cuando el
+// trabajo termina, el descriptor queda "listo para leer" (poll/epoll/select)
+// y read() devuelve una struct my_encrypt_completion. Así un solo hilo con un
+// event loop puede tener cientos de cifrados en curso.
+
+struct encrypt_async_job {
+    struct encrypt_job job;
+    struct kref ref;              // Una del descriptor y una del trabajador
+    wait_queue_head_t poll_wq;    // Aquí espera poll() hasta que termine
+    ktime_t start;
+    u64 elapsed_ns;
+};
+
+static void encrypt_async_release(struct kref *ref)
+{
+    struct encrypt_async_job *async = container_of(ref, struct encrypt_async_job, ref);
+
+    // Los archivos ya los cerró el trabajador (encrypt_files): aquí solo queda la ruta
+    kfree(async->job.input_filepath);
+    kfree(async);
+}
+
+// El trabajador terminó: avisamos a quien esté en poll() y soltamos su referencia
+static void encrypt_async_done(struct encrypt_job *job)
+{
+    struct encrypt_async_job *async = container_of(job, struct encrypt_async_job, job);
+
+    async->elapsed_ns = ktime_to_ns(ktime_sub(ktime_get(), async->start));
+    complete(&job->done);
+    wake_up_interruptible_poll(&async->poll_wq, EPOLLIN | EPOLLRDNORM);
+    kref_put(&async->ref, encrypt_async_release);
+}
+
+static __poll_t encrypt_async_poll(struct file *file, poll_table *wait)
+{
+    struct encrypt_async_job *async = file->private_data;
+
+    poll_wait(file, &async->poll_wq, wait);
+    return completion_done(&async->job.done) ? EPOLLIN | EPOLLRDNORM : 0;
+}
+
+// read() bloquea hasta que el trabajo termine (o da -EAGAIN con O_NONBLOCK)
+static ssize_t encrypt_async_read(struct file *file, char __user *buf, size_t count, loff_t *ppos)
+{
+    struct encrypt_async_job *async = file->private_data;
+    struct my_encrypt_completion result = {};
+
+    if (count < sizeof(result))
+        return -EINVAL;
+    if (!completion_done(&async->job.done)) {
+        if (file->f_flags & O_NONBLOCK)
+            return -EAGAIN;
+        if (wait_for_completion_interruptible(&async->job.done))
+            return -ERESTARTSYS;
+    }
+
+    result.status = async->job.result;
+    result.elapsed_ns = async->elapsed_ns;
+    if (copy_to_user(buf, &result, sizeof(result)))
+        return -EFAULT;
+    return sizeof(result);
+}
+
+// Cerrar el descriptor no cancela el trabajo: el trabajador conserva su referencia
+static int encrypt_async_release_file(struct inode *inode, struct file *file)
+{
+    struct encrypt_async_job *async = file->private_data;
+
+    kref_put(&async->ref, encrypt_async_release);
+    return 0;
+}
+
+static const struct file_operations encrypt_async_fops = {
+    .owner   = THIS_MODULE,
+    .poll    = encrypt_async_poll,
+    .read    = encrypt_async_read,
+    .release = encrypt_async_release_file,
+    .llseek  = noop_llseek,
+};
+
+// Mismos argumentos que my_encrypt_ex, pero devuelve un descriptor en lugar de esperar.
+SYSCALL_DEFINE5(my_encrypt_submit, const char __user *, input_filepath, const char __user *, output_filepath,
+                const char __user *, key_filepath, int, thread_count, unsigned int, flags) {
+    struct encrypt_async_job *async;
+    struct encrypt_key *key;
+    char *k_key_filepath;
+    int fd, ret_val;
+
+    if (thread_count <= 0 || (flags & ~MY_ENCRYPT_F_ALL))
+        return -EINVAL;
+    thread_count = encrypt_clamp_threads(thread_count);
+    if (!encrypt_wq || !encrypt_io_wq || !encrypt_job_wq)
+        return -ENOMEM;
+
+    async = kzalloc(sizeof(*async), GFP_KERNEL);
+    if (!async)
+        return -ENOMEM;
+    // Referencia del trabajador; la del descriptor se toma abajo
+    kref_init(&async->ref);
+    init_waitqueue_head(&async->poll_wq);
+    INIT_WORK(&async->job.work, encrypt_job_work);
+    init_completion(&async->job.done);
+    async->job.done_fn = encrypt_async_done;
+    async->job.thread_count = thread_count;
+    async->job.flags = flags;
+
+    // Errores de clave, rutas o permisos se reportan en la syscall misma,
+    // no hace falta un descriptor para enterarse
+    k_key_filepath = strndup_user(key_filepath, PATH_MAX);
+    if (IS_ERR(k_key_filepath)) {
+        ret_val = PTR_ERR(k_key_filepath);
+        goto free_async;
+    }
+    key = encrypt_key_load(k_key_filepath, flags);
     kfree(k_key_filepath);
+    if (IS_ERR(key)) {
+        ret_val = PTR_ERR(key);
+        goto free_async;
+    }
+    async->job.key = key; // El trabajador la suelta al terminar
+
+    // Los archivos se abren aquí, con los permisos y el directorio actual de
+    // quien llama (ver encrypt_open_files); el trabajador solo los usa y los cierra.
+    // Después de la clave: si la clave falla, la salida no se trunca.
+    ret_val = encrypt_job_open(&async->job, input_filepath, output_filepath);
+    if (ret_val) {
+        encrypt_key_put(key);
+        goto free_async;
+    }
 
+    async->start = ktime_get();
+    kref_get(&async->ref);
+    fd = anon_inode_getfd("[my_encrypt]", &encrypt_async_fops, async, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        encrypt_key_put(key);
+        ret_val = fd;
+        goto free_async;
+    }
+
+    queue_work(encrypt_job_wq, &async->job.work);
+    return fd;
+
+free_async:
+    // El trabajo no llegó a encolarse: los archivos abiertos se cierran aquí
+    if (async->job.input_file) {
+        filp_close(async->job.output_file, NULL);
+        filp_close(async->job.input_file, NULL);
+    }
+    kfree(async->job.input_filepath);
+    kfree(async);
     return ret_val;
-}
\ No newline at end of file
+}
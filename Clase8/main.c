@@ -5,17 +5,72 @@
 #include <sys/syscall.h>
 #include <linux/unistd.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <errno.h>
+#include <poll.h>
+
+#include "linux-6.12.61/include/uapi/linux/my_encrypt.h"
+#include "encrypt_user.h"
 
 #define MY_ENCRYPT 548
+#define MY_ENCRYPT_EX 553
+#define MY_ENCRYPT_BATCH 554
+#define MY_ENCRYPT_SUBMIT 555
+
+// Trabajos asíncronos en curso a la vez (un descriptor por trabajo)
+#define ASYNC_WINDOW 256
+
+// Nombre del algoritmo -> bits MY_ENCRYPT_ALG_* (-1 si no se conoce)
+int parseAlgorithm(const char *name) {
+    if (strcmp(name, "xor") == 0)
+        return MY_ENCRYPT_ALG_XOR;
+    if (strcmp(name, "aes") == 0 || strcmp(name, "aes-ctr") == 0)
+        return MY_ENCRYPT_ALG_AES_CTR;
+    if (strcmp(name, "chacha20") == 0)
+        return MY_ENCRYPT_ALG_CHACHA20;
+    return -1;
+}
+
+// true = no intentar la syscall, cifrar siempre en espacio de usuario (-u / --user)
+static bool force_user = false;
+
+// Cifra un archivo con la syscall. Si el kernel no la tiene (ENOSYS), o con -u,
+// usa el motor de espacio de usuario (encrypt_user.h), que da la misma salida.
+long encryptFile(const char *input, const char *output, const char *key, int threads_numbers, unsigned int flags) {
+    static bool warned = false;
+    long result;
+    int ret;
+
+    if (!force_user) {
+        if (flags)
+            result = syscall(MY_ENCRYPT_EX, input, output, key, threads_numbers, flags);
+        else
+            result = syscall(MY_ENCRYPT, input, output, key, threads_numbers);
+        if (result >= 0 || errno != ENOSYS)
+            return result;
+        if (!warned) {
+            printf("El kernel no tiene la syscall: se usa el motor en espacio de usuario\n");
+            warned = true;
+        }
+    }
+
+    ret = encrypt_file_user(input, output, key, threads_numbers, flags);
+    if (ret < 0) {
+        errno = -ret;
+        return -1;
+    }
+    return 0;
+}
 
 void encryptAnalizer(){
     char file_input[256] = {0}, file_output[256] = {0}, key[256] = {0};
     int threads_numbers = 0;
+    unsigned int flags = 0;
     char command[256];
     bool run = true;
 
     while(run){
-        printf("\nIngrese un parametro (-p, -o, -k, -j o run para ejecutar): ");
+        printf("\nIngrese un parametro (-p, -o, -k, -j, -i, -z, -a, -u o run para ejecutar): ");
         fgets(command, sizeof(command), stdin);
         command[strcspn(command, "\n")] = 0;
 
@@ -39,18 +94,46 @@ void encryptAnalizer(){
             scanf("%d", &threads_numbers);
             getchar();
 
+        } else if (strcmp(command, "-i") == 0) {
+            flags ^= MY_ENCRYPT_F_INPLACE;
+            printf("Cifrar sobre el mismo archivo: %s\n", (flags & MY_ENCRYPT_F_INPLACE) ? "si" : "no");
+
+        } else if (strcmp(command, "-z") == 0) {
+            flags ^= MY_ENCRYPT_F_ZEROCOPY;
+            printf("Leer directo de la page cache: %s\n", (flags & MY_ENCRYPT_F_ZEROCOPY) ? "si" : "no");
+
+        } else if (strcmp(command, "-a") == 0) {
+            char name[32];
+            int alg;
+            printf("Algoritmo (xor, aes, chacha20): ");
+            fgets(name, sizeof(name), stdin);
+            name[strcspn(name, "\n")] = 0;
+            alg = parseAlgorithm(name);
+            if (alg < 0) {
+                printf("Algoritmo no reconocido\n");
+                continue;
+            }
+            flags = (flags & ~MY_ENCRYPT_ALG_MASK) | alg;
+            printf("Algoritmo: %s\n", name);
+
+        } else if (strcmp(command, "-u") == 0) {
+            force_user = !force_user;
+            printf("Cifrar en espacio de usuario (sin syscall): %s\n", force_user ? "si" : "no");
+
         } else if (strcmp(command, "run") == 0) {
 
-            if (strlen(file_input) == 0 || strlen(file_output) == 0 || strlen(key) == 0 || threads_numbers == 0) {
+            // En modo in-place no hace falta archivo de salida
+            bool needs_output = !(flags & MY_ENCRYPT_F_INPLACE);
+            if (strlen(file_input) == 0 || (needs_output && strlen(file_output) == 0) || strlen(key) == 0 || threads_numbers == 0) {
                 printf("\nFaltan parametros obligatorios ...\n");
                 continue;
             }
 
-            long result = syscall(MY_ENCRYPT, file_input, file_output, key, threads_numbers);
+            long result = encryptFile(file_input, needs_output ? file_output : NULL, key, threads_numbers, flags);
             if (result >= 0)
                 printf("Archivo encriptado exitosamente\n");
             else
-                printf("Ocurrió un error\n");
+                printf("Ocurrió un error: %s\n", strerror(errno));
 
             return;  
         } else {
@@ -83,7 +166,173 @@ void analizer() {
     }
 }
 
-int main() {
+// Envía cada archivo con my_encrypt_submit y espera los resultados con poll():
+// un solo hilo mantiene hasta ASYNC_WINDOW cifrados en curso.
+size_t asyncEncrypt(struct my_encrypt_batch_entry *entries, size_t count, const char *key, int threads_numbers, unsigned int flags) {
+    struct pollfd fds[ASYNC_WINDOW];
+    size_t owner[ASYNC_WINDOW];
+    size_t next = 0, failed = 0;
+    int inflight = 0;
+
+    while (next < count || inflight > 0) {
+        // Llenamos la ventana con nuevos envíos
+        while (next < count && inflight < ASYNC_WINDOW) {
+            long fd = syscall(MY_ENCRYPT_SUBMIT, (char *)(uintptr_t)entries[next].input,
+                              (char *)(uintptr_t)entries[next].output, key, threads_numbers, flags);
+            if (fd < 0 && errno == ENOSYS) {
+                // Sin syscall asíncrona: este archivo se cifra aquí mismo
+                entries[next].status = encryptFile((char *)(uintptr_t)entries[next].input,
+                                                   (char *)(uintptr_t)entries[next].output,
+                                                   key, threads_numbers, flags) < 0 ? -errno : 0;
+            } else if (fd < 0) {
+                entries[next].status = -errno;
+            } else {
+                fds[inflight].fd = (int)fd;
+                fds[inflight].events = POLLIN;
+                owner[inflight] = next;
+                inflight++;
+            }
+            next++;
+        }
+        if (inflight == 0)
+            break;
+
+        if (poll(fds, inflight, -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            perror("poll");
+            break;
+        }
+
+        // Recogemos los que terminaron y compactamos la ventana
+        for (int i = 0; i < inflight; ) {
+            struct my_encrypt_completion done;
+            if (!(fds[i].revents & POLLIN)) {
+                i++;
+                continue;
+            }
+            if (read(fds[i].fd, &done, sizeof(done)) == sizeof(done))
+                entries[owner[i]].status = done.status;
+            else
+                entries[owner[i]].status = -EIO;
+            close(fds[i].fd);
+            inflight--;
+            fds[i] = fds[inflight];
+            owner[i] = owner[inflight];
+        }
+    }
+
+    for (size_t i = 0; i < count; i++)
+        if (entries[i].status != 0)
+            failed++;
+    return failed;
+}
+
+// Modo lote (no interactivo): cifra todos los archivos de un manifiesto
+// con una sola clave. Cada línea del manifiesto es "entrada salida"
+// (o solo "entrada" con -i). Las líneas vacías o que empiezan con # se ignoran.
+int batchEncrypt(const char *manifest_path, const char *key, int threads_numbers, unsigned int flags, bool async) {
+    FILE *manifest = fopen(manifest_path, "r");
+    struct my_encrypt_batch_entry *entries = NULL;
+    char line[2 * 4096 + 2], input[4096], output[4096];
+    size_t count = 0, capacity = 0, failed = 0;
+
+    if (!manifest) {
+        perror("No se pudo abrir el manifiesto");
+        return 1;
+    }
+
+    while (fgets(line, sizeof(line), manifest)) {
+        int fields = sscanf(line, "%4095s %4095s", input, output);
+        if (fields <= 0 || input[0] == '#')
+            continue;
+        if (fields < 2 && !(flags & MY_ENCRYPT_F_INPLACE)) {
+            fprintf(stderr, "Linea sin archivo de salida: %s", line);
+            continue;
+        }
+        if (count == capacity) {
+            capacity = capacity ? capacity * 2 : 64;
+            entries = realloc(entries, capacity * sizeof(*entries));
+            if (!entries) {
+                fprintf(stderr, "Sin memoria para el lote\n");
+                fclose(manifest);
+                return 1;
+            }
+        }
+        memset(&entries[count], 0, sizeof(entries[count]));
+        entries[count].input = (uintptr_t)strdup(input);
+        entries[count].output = (flags & MY_ENCRYPT_F_INPLACE) ? 0 : (uintptr_t)strdup(output);
+        count++;
+    }
+    fclose(manifest);
+
+    if (async && !force_user) {
+        failed = asyncEncrypt(entries, count, key, threads_numbers, flags);
+        for (size_t i = 0; i < count; i++)
+            if (entries[i].status != 0)
+                printf("ERROR %s: %s\n", (char *)(uintptr_t)entries[i].input, strerror(-entries[i].status));
+    }
+
+    // La syscall acepta hasta MY_ENCRYPT_BATCH_MAX archivos por llamada
+    for (size_t done = 0; (!async || force_user) && done < count; done += MY_ENCRYPT_BATCH_MAX) {
+        size_t slice = count - done < MY_ENCRYPT_BATCH_MAX ? count - done : MY_ENCRYPT_BATCH_MAX;
+        long result = force_user ? -1 : syscall(MY_ENCRYPT_BATCH, entries + done, (unsigned int)slice, key, threads_numbers, flags);
+        if (result < 0 && (force_user || errno == ENOSYS)) {
+            // Sin syscall de lote: archivo por archivo (encryptFile usa el motor de usuario)
+            for (size_t i = done; i < done + slice; i++)
+                entries[i].status = encryptFile((char *)(uintptr_t)entries[i].input,
+                                                (char *)(uintptr_t)entries[i].output,
+                                                key, threads_numbers, flags) < 0 ? -errno : 0;
+            result = 0;
+        }
+        if (result < 0) {
+            perror("Ocurrió un error en el lote");
+            failed += slice;
+            continue;
+        }
+        for (size_t i = done; i < done + slice; i++) {
+            if (entries[i].status != 0) {
+                printf("ERROR %s: %s\n", (char *)(uintptr_t)entries[i].input, strerror(-entries[i].status));
+                failed++;
+            }
+        }
+    }
+
+    printf("%zu archivos, %zu encriptados, %zu con error\n", count, count - failed, failed);
+    for (size_t i = 0; i < count; i++) {
+        free((void *)(uintptr_t)entries[i].input);
+        free((void *)(uintptr_t)entries[i].output);
+    }
+    free(entries);
+    return failed ? 1 : 0;
+}
+
+int main(int argc, char **argv) {
+    // ./encrypt --batch <manifiesto> <clave> <hilos> [-i] [-z] [--async] [--user] [--alg xor|aes|chacha20]
+    if (argc >= 5 && strcmp(argv[1], "--batch") == 0) {
+        unsigned int flags = 0;
+        bool async = false;
+        for (int i = 5; i < argc; i++) {
+            if (strcmp(argv[i], "-i") == 0)
+                flags |= MY_ENCRYPT_F_INPLACE;
+            else if (strcmp(argv[i], "-z") == 0)
+                flags |= MY_ENCRYPT_F_ZEROCOPY;
+            else if (strcmp(argv[i], "--async") == 0)
+                async = true;
+            else if (strcmp(argv[i], "--user") == 0)
+                force_user = true;
+            else if (strcmp(argv[i], "--alg") == 0 && i + 1 < argc) {
+                int alg = parseAlgorithm(argv[++i]);
+                if (alg < 0) {
+                    fprintf(stderr, "Algoritmo no reconocido: %s\n", argv[i]);
+                    return 1;
+                }
+                flags |= alg;
+            }
+        }
+        return batchEncrypt(argv[2], argv[3], atoi(argv[4]), flags, async);
+    }
+
     analizer();
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,93 @@
+/*
+ * Microbenchmark del XOR de my_encrypt.
+ * Compara el bucle original (byte a byte con %) contra xor_stream
+ * (de 8 en 8 bytes con la clave expandida) para varios largos de clave,
+ * y verifica que ambos den exactamente el mismo resultado.
+ *
+ * Compilar: gcc -O2 -o xor_bench xor_bench.c
+ * Ejecutar: ./xor_bench [MiB]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "linux-6.12.61/kernel/encrypt_xor.h"
+
+#define REPEAT 5
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// El bucle original de perform_xor_operation
+static void xor_scalar(unsigned char *buf, size_t len, const unsigned char *key, size_t key_length, size_t offset) {
+    for (size_t i = 0; i < len; i++)
+        buf[i] ^= key[(offset + i) % key_length];
+}
+
+// Aplica xor_stream como lo hace el kernel: en fragmentos que empiezan en posiciones arbitrarias
+static void xor_fragments(unsigned char *buf, size_t len, const unsigned char *stream, size_t span, size_t key_length, size_t fragments) {
+    size_t fragment_size = len / fragments;
+    for (size_t f = 0; f < fragments; f++) {
+        size_t start = f * fragment_size;
+        size_t end = (f == fragments - 1) ? len : start + fragment_size;
+        xor_stream(buf + start, end - start, stream, span, start % key_length);
+    }
+}
+
+int main(int argc, char **argv) {
+    size_t mib = argc > 1 ? strtoul(argv[1], NULL, 10) : 256;
+    size_t len = mib << 20;
+    // Largos de clave: muy corta, no potencia de 2, típicas, más grande que XOR_MIN_SPAN
+    size_t key_lengths[] = {1, 7, 16, 23, 32, 256, 4096, 65537};
+    unsigned char *data = malloc(len), *a = malloc(len), *b = malloc(len);
+
+    if (!data || !a || !b) {
+        fprintf(stderr, "No hay memoria para %zu MiB\n", mib);
+        return 1;
+    }
+    srand(548);
+    for (size_t i = 0; i < len; i++)
+        data[i] = rand();
+
+    printf("%-10s %14s %14s %8s %s\n", "clave", "escalar MB/s", "palabras MB/s", "mejora", "igual");
+    for (size_t k = 0; k < sizeof(key_lengths) / sizeof(key_lengths[0]); k++) {
+        size_t key_length = key_lengths[k];
+        unsigned char *key = malloc(key_length);
+        unsigned char *stream = malloc(xor_key_span(key_length));
+        double t0, dt, best_scalar = 1e9, best_words = 1e9;
+
+        for (size_t i = 0; i < key_length; i++)
+            key[i] = rand();
+        xor_key_expand(stream, key, key_length);
+
+        for (int r = 0; r < REPEAT; r++) {
+            memcpy(a, data, len);
+            t0 = now_sec();
+            xor_scalar(a, len, key, key_length, 0);
+            dt = now_sec() - t0;
+            if (dt < best_scalar) best_scalar = dt;
+
+            memcpy(b, data, len);
+            t0 = now_sec();
+            // 7 fragmentos: ninguna frontera cae en múltiplo de 8 ni de la clave
+            xor_fragments(b, len, stream, xor_key_span(key_length), key_length, 7);
+            dt = now_sec() - t0;
+            if (dt < best_words) best_words = dt;
+        }
+
+        printf("%-10zu %14.0f %14.0f %7.1fx %s\n", key_length,
+               len / best_scalar / 1e6, len / best_words / 1e6,
+               best_scalar / best_words, memcmp(a, b, len) == 0 ? "si" : "NO");
+        free(key);
+        free(stream);
+    }
+
+    free(data);
+    free(a);
+    free(b);
+    return 0;
+}